@@ -5,13 +5,16 @@
 #include <cstdlib>
 #include <string>
 #include <algorithm>
+#include <future>
+#include <thread>
+#include <vector>
 #include "rotateBST.h"
 
 using namespace std;
 /**
 * A special kind of node for an AVL tree, which adds the height as a data member, plus 
-* other additional helper functions. You do NOT need to implement any functionality or
-* add additional data members or helper functions.
+* other additional helper functions. The only member added is trivially destructible,
+* so code that only knows about the Node base may still destroy an AVLNode.
 */
 template <typename Key, typename Value>
 class AVLNode : public Node<Key, Value>
@@ -19,18 +22,19 @@ class AVLNode : public Node<Key, Value>
 public:
 	// Constructor/destructor.
     AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    AVLNode(std::pair<Key, Value>&& item, AVLNode<Key, Value>* parent);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int getHeight() const;
     void setHeight(int height);
     
-    // Getters for parent, left, and right. These need to be redefined since they 
+    // Getters for parent, left, and right. These shadow the ones in Node since they 
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    AVLNode<Key, Value>* getParent() const;
+    AVLNode<Key, Value>* getLeft() const;
+    AVLNode<Key, Value>* getRight() const;
 
 protected:
     int mHeight;
@@ -53,6 +57,17 @@ AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Va
 
 }
 
+/**
+* Constructor for an AVLNode that moves an already built item into the node.
+*/
+template<typename Key, typename Value>
+AVLNode<Key, Value>::AVLNode(std::pair<Key, Value>&& item, AVLNode<Key, Value>* parent)
+    : Node<Key, Value>(std::move(item), parent)
+    , mHeight(0)
+{
+
+}
+
 /**
 * Destructor.
 */
@@ -81,7 +96,7 @@ void AVLNode<Key, Value>::setHeight(int height)
 }
 
 /**
-* Getter function for the parent. Used since the node inherits from a base node.
+* Getter function for the parent. Shadows the base getter since the node inherits from a base node.
 */
 template<typename Key, typename Value>
 AVLNode<Key, Value>* AVLNode<Key, Value>::getParent() const
@@ -90,7 +105,7 @@ AVLNode<Key, Value>* AVLNode<Key, Value>::getParent() const
 }
 
 /**
-* Getter function for the left child. Used since the node inherits from a base node.
+* Getter function for the left child. Shadows the base getter since the node inherits from a base node.
 */
 template<typename Key, typename Value>
 AVLNode<Key, Value>* AVLNode<Key, Value>::getLeft() const
@@ -99,7 +114,7 @@ AVLNode<Key, Value>* AVLNode<Key, Value>::getLeft() const
 }
 
 /**
-* Getter function for the right child. Used since the node inherits from a base node.
+* Getter function for the right child. Shadows the base getter since the node inherits from a base node.
 */
 template<typename Key, typename Value>
 AVLNode<Key, Value>* AVLNode<Key, Value>::getRight() const
@@ -107,6 +122,24 @@ AVLNode<Key, Value>* AVLNode<Key, Value>::getRight() const
     return static_cast<AVLNode<Key,Value>*>(this->mRight);
 }
 
+/**
+* Overload of the validation hook in bst.h that checks an AVLNode's stored height.
+*/
+template<typename Key, typename Value>
+bool heightMatches(const AVLNode<Key, Value>* node, int height)
+{
+    return node->getHeight() == height;
+}
+
+/**
+* Overload of the build hook in bst.h that records an AVLNode's height.
+*/
+template<typename Key, typename Value>
+void storeHeight(AVLNode<Key, Value>* node, int height)
+{
+    node->setHeight(height);
+}
+
 /*
 ------------------------------------------
 End implementations for the AVLNode class.
@@ -114,396 +147,611 @@ End implementations for the AVLNode class.
 */
 
 /**
-* A templated balanced binary search tree implemented as an AVL tree.
+* An AVLNode that also keeps the number of nodes in its subtree. Trees built
+* from these nodes answer rank and selection queries in logarithmic time.
 */
-template <class Key, class Value>
-class AVLTree : public rotateBST<Key, Value>
+template <typename Key, typename Value>
+class CountedAVLNode : public AVLNode<Key, Value>
 {
 public:
-	// Methods for inserting/removing elements from the tree. You must implement
-	// both of these methods. 
-    virtual void insert(const std::pair<Key, Value>& keyValuePair) override;
-    void remove(const Key& key);
+    CountedAVLNode(const Key& key, const Value& value, CountedAVLNode<Key, Value>* parent);
+    CountedAVLNode(std::pair<Key, Value>&& item, CountedAVLNode<Key, Value>* parent);
 
-private:
-    void insertHelper(const std::pair<Key, Value>& keyValuePair, AVLNode<Key,Value>* root);
-    void rebalanceNode(AVLNode<Key,Value>* root);
-    bool returnBalanced(AVLNode<Key,Value>* root) const;
-    void updateHeight(AVLNode<Key,Value>* root);
-    void removeHelper(const Key& key, AVLNode<Key,Value>* root);
-    AVLNode<Key, Value>* getPredecessor(AVLNode<Key,Value>* root);
-    void swapPred(AVLNode<Key,Value>* remove , AVLNode<Key,Value>* pred);
+    // Getter/setter for the number of nodes in the subtree rooted here.
+    std::size_t getSize() const;
+    void setSize(std::size_t size);
 
-	/* Helper functions are strongly encouraged to help separate the problem
-	   into smaller pieces. You should not need additional data members. */
+    // Getters for parent, left, and right, shadowing those in AVLNode.
+    CountedAVLNode<Key, Value>* getParent() const;
+    CountedAVLNode<Key, Value>* getLeft() const;
+    CountedAVLNode<Key, Value>* getRight() const;
+
+protected:
+    std::size_t mSize;
 };
 
 /*
---------------------------------------------
-Begin implementations for the AVLTree class.
---------------------------------------------
+---------------------------------------------------
+Begin implementations for the CountedAVLNode class.
+---------------------------------------------------
 */
 
 /**
-* Insert function for a key value pair. Finds location to insert the node and then balances the tree. 
+* Constructor for a CountedAVLNode. Nodes start out as a subtree of one.
 */
 template<typename Key, typename Value>
-void AVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+CountedAVLNode<Key, Value>::CountedAVLNode(const Key& key, const Value& value, CountedAVLNode<Key, Value>* parent)
+    : AVLNode<Key, Value>(key, value, parent)
+    , mSize(1)
 {
-    insertHelper(keyValuePair, dynamic_cast<AVLNode<Key,Value>*>(this->mRoot));  
+
 }
 
-/** 
-* Helper function for remove that recursively finds where the location to insert  
-* the node. Once found it inserts and on it's way back up updates each node's 
-* height, constantly checking to see if the node is unbalanced or not. If 
-* unbalanced it calls the rebalance function which rebalnces the tree. 
-* */
+/**
+* Constructor for a CountedAVLNode that moves an already built item into the node.
+*/
 template<typename Key, typename Value>
-void AVLTree<Key, Value>::insertHelper(const std::pair<Key, Value>& keyValuePair, AVLNode<Key,Value>* root) 
-{      
-    if(this->mRoot == nullptr) {
-
-        AVLNode<Key,Value>* leaf = new AVLNode<Key,Value>(keyValuePair.first, keyValuePair.second,nullptr);
-        leaf->setHeight(1);
-        this->mRoot = leaf;
-        return;
-
-    } else if(keyValuePair.first < root->getKey()) {
-
-        if(root->getLeft() == nullptr) 
-        {
-            AVLNode<Key,Value>* leaf = new AVLNode<Key,Value>(keyValuePair.first, keyValuePair.second, root);
-            root->setLeft(leaf);
-            leaf->setHeight(1);
-
-        } else {
-
-            insertHelper(keyValuePair, root->getLeft());
-        }
-    } 
-    else if(keyValuePair.first > root->getKey()) 
-    {
-        if(root->getRight() == nullptr) 
-        {
-            AVLNode<Key,Value>* leaf = new AVLNode<Key,Value>(keyValuePair.first, keyValuePair.second, root);
-            root->setRight(leaf);
-            leaf->setHeight(1);
-        } 
-        else 
-        {
-            insertHelper(keyValuePair, root->getRight());
-        }
-    } 
-    else 
-    {
-        root->setValue(keyValuePair.second);
-    }
+CountedAVLNode<Key, Value>::CountedAVLNode(std::pair<Key, Value>&& item, CountedAVLNode<Key, Value>* parent)
+    : AVLNode<Key, Value>(std::move(item), parent)
+    , mSize(1)
+{
 
-    if(root->getRight() && root->getLeft()) {
-        root->setHeight((std::max(root->getRight()->getHeight(), root->getLeft()->getHeight()))+1);
-    } else if(root->getRight()) {
-        root->setHeight(root->getRight()->getHeight() + 1);
-    } else if(root->getLeft()) {
-        root->setHeight(root->getLeft()->getHeight() + 1);
-    }
+}
 
+/**
+* Getter function for the subtree size.
+*/
+template<typename Key, typename Value>
+std::size_t CountedAVLNode<Key, Value>::getSize() const
+{
+    return mSize;
+}
 
-    bool unbalanced = returnBalanced(root);
+/**
+* Setter function for the subtree size.
+*/
+template<typename Key, typename Value>
+void CountedAVLNode<Key, Value>::setSize(std::size_t size)
+{
+    mSize = size;
+}
 
-    if(unbalanced) {
-        rebalanceNode(root);
-    }
+/**
+* Getter function for the parent, shadowing the one in AVLNode.
+*/
+template<typename Key, typename Value>
+CountedAVLNode<Key, Value>* CountedAVLNode<Key, Value>::getParent() const
+{
+    return static_cast<CountedAVLNode<Key,Value>*>(this->mParent);
 }
 
-/** 
-* Algorithm that decides which way to rotate an unbalanced tree.
-* Also updates the heights after rebalancing in constant time.
+/**
+* Getter function for the left child, shadowing the one in AVLNode.
 */
 template<typename Key, typename Value>
-void AVLTree<Key,Value>::rebalanceNode(AVLNode<Key,Value>* root) {
+CountedAVLNode<Key, Value>* CountedAVLNode<Key, Value>::getLeft() const
+{
+    return static_cast<CountedAVLNode<Key,Value>*>(this->mLeft);
+}
 
+/**
+* Getter function for the right child, shadowing the one in AVLNode.
+*/
+template<typename Key, typename Value>
+CountedAVLNode<Key, Value>* CountedAVLNode<Key, Value>::getRight() const
+{
+    return static_cast<CountedAVLNode<Key,Value>*>(this->mRight);
+}
 
-    int lheight = 0;
-    int rheight = 0;
-    int rsubHeight  = 0;
-    int lsubHeight = 0;
+/**
+* Returns the size of the subtree rooted at a node, treating an empty subtree as 0.
+*/
+template<typename Key, typename Value>
+std::size_t subtreeSize(const CountedAVLNode<Key, Value>* node)
+{
+    return node ? node->getSize() : 0;
+}
 
-    AVLNode<Key,Value>* parent = root;
-    AVLNode<Key,Value>* firstChild;
+/**
+* Overload of the count hook in bst.h that recomputes a node's subtree size.
+*/
+template<typename Key, typename Value>
+void updateCount(CountedAVLNode<Key, Value>* node)
+{
+    node->setSize(1 + subtreeSize(node->getLeft()) + subtreeSize(node->getRight()));
+}
 
-    bool one = false;
+/**
+* Overload of the validation hook in bst.h that checks a node's subtree size.
+*/
+template<typename Key, typename Value>
+bool countMatches(const CountedAVLNode<Key, Value>* node, std::size_t size)
+{
+    return node->getSize() == size;
+}
 
-    if(root->getRight()) {
-        rheight = root->getRight()->getHeight();
-    }
-    if(root->getLeft()) {
-        lheight = root->getLeft()->getHeight();
-    }
+/**
+* Overload of the size hook in bst.h, which for counted nodes always knows.
+*/
+template<typename Key, typename Value>
+bool storedSize(const CountedAVLNode<Key, Value>* node, std::size_t& size)
+{
+    size = subtreeSize(node);
+    return true;
+}
 
-    if(rheight > lheight) 
-    {
-        firstChild = root->getRight();
+/*
+-------------------------------------------------
+End implementations for the CountedAVLNode class.
+-------------------------------------------------
+*/
 
-        if(firstChild->getRight()) 
-        {
-            rsubHeight = firstChild->getRight()->getHeight();
+/**
+* A templated balanced binary search tree implemented as an AVL tree. The node
+* type may be swapped for another kind of AVLNode, such as a CountedAVLNode for
+* order statistics (see OrderedAVLTree below).
+*/
+template <class Key, class Value, class NodeType = AVLNode<Key, Value> >
+class AVLTree : public rotateBST<Key, Value>
+{
+public:
+    AVLTree();
+    explicit AVLTree(const std::shared_ptr<NodeAllocator>& allocator);
+    AVLTree(const AVLTree& other);
+    AVLTree(AVLTree&& other);
+    AVLTree& operator=(const AVLTree& other);
+    AVLTree& operator=(AVLTree&& other);
+
+	// Inserting goes through the insert/emplace family in bst.h, which calls
+	// attachItem() below to create the node and rebalance the tree. 
+    void remove(const Key& key);
 
-        } 
+    // Validation that also checks every stored height against the real one.
+    TreeStats validate() const;
+
+    // Day-Stout-Warren on the AVLNodes, which also stores their new heights.
+    virtual void rebalance() override;
+
+    // Order statistics. These need a counted node type such as CountedAVLNode.
+    std::size_t rank(const Key& key) const;
+    typename rotateBST<Key, Value>::iterator select(std::size_t index) const;
+    std::size_t countRange(const Key& low, const Key& high) const;
+
+    // Set operations, each taking O(m log(n/m + 1)) time for trees of m and
+    // n >= m items. Items of the other tree are taken over by union_with,
+    // where its values win over this tree's; pass it with std::move to
+    // hand over its nodes instead of copying them.
+    void union_with(AVLTree other);
+    void intersect_with(const AVLTree& other);
+    void difference(const AVLTree& other);
+
+    // Splitting off the keys >= key and appending a tree of larger keys, both
+    // in O(log n) by relinking the existing nodes.
+    AVLTree split(const Key& key);
+    void concat(AVLTree other);
+
+    // Inserting or erasing a whole batch of items or keys in one walk down
+    // the tree, rebalancing on the way back up. Within an insert batch the
+    // last item for a key wins, and any item replaces the value of a key
+    // already present, as insert() does.
+    template<typename InputIterator>
+    void insert_batch(InputIterator first, InputIterator last);
+    template<typename InputIterator>
+    void erase_batch(InputIterator first, InputIterator last);
 
-        if(firstChild->getLeft()) 
-        {
-            lsubHeight = firstChild->getLeft()->getHeight();
-        }
+protected:
+    virtual Node<Key, Value>* attachItem(Node<Key, Value>* parent, std::pair<Key, Value>&& item) override;
+    virtual Node<Key, Value>* cloneRoot(const Node<Key, Value>* root) override;
+    virtual void buildBalanced(std::vector<std::pair<Key, Value> >& items) override;
+    virtual void removeNode(Node<Key, Value>* node) override;
 
-        if(rsubHeight >= lsubHeight) {
+private:
+    NodeType* rebalanceNode(NodeType* root, Node<Key, Value>*& top);
+    bool returnBalanced(NodeType* root) const;
+    void updateHeight(NodeType* root);
+    void retrace(NodeType* root, Node<Key, Value>*& top);
+    void removeHelper(NodeType* to_remove);
+    NodeType* getPredecessor(NodeType* root);
+    void swapPred(NodeType* remove , NodeType* pred);
+    static int heightOf(const NodeType* root);
+
+    // Join and split work on detached subtrees, whose roots have no parent.
+    NodeType* join(NodeType* left, NodeType* middle, NodeType* right);
+    NodeType* join2(NodeType* left, NodeType* right);
+    void split(NodeType* root, const Key& key, NodeType*& less, NodeType*& match, NodeType*& greater);
+    NodeType* unionNodes(NodeType* a, NodeType* b, std::vector<Node<Key, Value>*>& discarded, int forks);
+    NodeType* intersectNodes(NodeType* a, const NodeType* b, std::vector<Node<Key, Value>*>& discarded, int forks);
+    NodeType* differenceNodes(NodeType* a, const NodeType* b, std::vector<Node<Key, Value>*>& discarded, int forks);
+    template<typename Branch>
+    void bothSides(bool fork, const Branch& branch, NodeType*& left, NodeType*& right,
+        std::vector<Node<Key, Value>*>& discarded);
+    NodeType* insertSorted(NodeType* root, std::vector<std::pair<Key, Value> >& items,
+        std::size_t first, std::size_t last, std::size_t& added);
+    NodeType* eraseSorted(NodeType* root, const std::vector<Key>& keys,
+        std::size_t first, std::size_t last, std::size_t& removed);
+    NodeType* adoptNodes(AVLTree& other);
+    std::size_t destroyAll(const std::vector<Node<Key, Value>*>& discarded);
+    static std::size_t addSizes(std::size_t a, std::size_t b);
+    static std::size_t subtractSize(std::size_t size, std::size_t freed);
+    static NodeType* detach(NodeType* root);
+    static int forkDepth();
+
+    // Subtrees at least this high on both sides are worth a thread of their own.
+    static const int kForkHeight = 14;
+
+    static const bool kCounted = std::is_base_of<CountedAVLNode<Key, Value>, NodeType>::value;
 
-            this->leftRotate(parent);
-            one = true;
+	/* Helper functions are strongly encouraged to help separate the problem
+	   into smaller pieces. You should not need additional data members. */
+};
 
-        } else {
+/**
+* An AVL tree whose nodes track their subtree sizes, supporting rank, select
+* and countRange in logarithmic time at the cost of one word per node and a
+* full walk to the root on every insert and remove.
+*/
+template <class Key, class Value>
+using OrderedAVLTree = AVLTree<Key, Value, CountedAVLNode<Key, Value> >;
 
-            this->rightRotate(firstChild);
-            this->leftRotate(parent);
+/*
+--------------------------------------------
+Begin implementations for the AVLTree class.
+--------------------------------------------
+*/
 
-        }
+/**
+* Default constructor. Nodes are drawn from a pool owned by this tree.
+*/
+template<typename Key, typename Value, typename NodeType>
+AVLTree<Key, Value, NodeType>::AVLTree() : rotateBST<Key, Value>() { }
 
-    } else if(lheight > rheight) {
+/**
+* Constructor that draws nodes from the given allocator.
+*/
+template<typename Key, typename Value, typename NodeType>
+AVLTree<Key, Value, NodeType>::AVLTree(const std::shared_ptr<NodeAllocator>& allocator)
+    : rotateBST<Key, Value>(allocator) { }
 
-        firstChild = root->getLeft();
+/**
+* Copy constructor. The copy keeps the original's shape and heights.
+*/
+template<typename Key, typename Value, typename NodeType>
+AVLTree<Key, Value, NodeType>::AVLTree(const AVLTree& other)
+    : rotateBST<Key, Value>()
+{
+    this->mRoot = cloneRoot(other.mRoot);
+    this->resetBounds(other.mSize);
+}
 
-        if(firstChild->getRight()) 
-        {
-            rsubHeight = firstChild->getRight()->getHeight();
-        } 
+/**
+* Move constructor, which takes the other tree's nodes and leaves it empty.
+*/
+template<typename Key, typename Value, typename NodeType>
+AVLTree<Key, Value, NodeType>::AVLTree(AVLTree&& other)
+    : rotateBST<Key, Value>(std::move(other)) { }
 
-        if(firstChild->getLeft()) 
-        {
-            lsubHeight = firstChild->getLeft()->getHeight();
-        }
+/**
+* Copy assignment. The base class copies the nodes through cloneRoot().
+*/
+template<typename Key, typename Value, typename NodeType>
+AVLTree<Key, Value, NodeType>& AVLTree<Key, Value, NodeType>::operator=(const AVLTree& other)
+{
+    rotateBST<Key, Value>::operator=(other);
+    return *this;
+}
 
-        if(lsubHeight >= rsubHeight) 
-        {
-            this->rightRotate(parent);
-            one = true;
+/**
+* Move assignment.
+*/
+template<typename Key, typename Value, typename NodeType>
+AVLTree<Key, Value, NodeType>& AVLTree<Key, Value, NodeType>::operator=(AVLTree&& other)
+{
+    rotateBST<Key, Value>::operator=(std::move(other));
+    return *this;
+}
 
-        } else {
+/**
+* Creates the AVLNode for an item whose key is absent, hangs it below the
+* parent the insert walk found, and then retraces back up through the parent
+* pointers to balance the tree. 
+*/
+template<typename Key, typename Value, typename NodeType>
+Node<Key, Value>* AVLTree<Key, Value, NodeType>::attachItem(Node<Key, Value>* parent, std::pair<Key, Value>&& item)
+{
+    NodeType* root = static_cast<NodeType*>(parent);
+    NodeType* leaf = this->template createNode<NodeType>(std::move(item), root);
+    leaf->setHeight(1);
 
-            this->leftRotate(firstChild);
-            this->rightRotate(parent);
-        }
+    if(root == nullptr) 
+    {
+        this->mRoot = leaf;
+        this->trackAttached(leaf);
+        return leaf;
     }
 
-    if(one) 
+    if(leaf->getKey() < root->getKey()) 
     {
-        parent->setHeight(parent->getHeight()-2);
+        root->setLeft(leaf);
 
     } else {
 
-        parent->setHeight(parent->getHeight()-2);
-        parent->getParent()->setHeight(parent->getParent()->getHeight()+1);
-        firstChild->setHeight(firstChild->getHeight()-1);
+        root->setRight(leaf);
     }
+    this->trackAttached(leaf);
+    retrace(root, this->mRoot);
+    return leaf;
 }
 
 /**
-* Function that recursively updates the heights at a given node.
+* Copies AVLNodes, along with their heights, when the tree is copied.
 */
-template<typename Key, typename Value>
-void AVLTree<Key,Value>::updateHeight(AVLNode<Key,Value>* root) {
-        
-    AVLNode<Key,Value>* lchild = root->getLeft();
-    AVLNode<Key,Value>* rchild = root->getRight();
-
-    int rightHeight = 0;
-    int leftHeight = 0;
+template<typename Key, typename Value, typename NodeType>
+Node<Key, Value>* AVLTree<Key, Value, NodeType>::cloneRoot(const Node<Key, Value>* root)
+{
+    return this->cloneNodes(static_cast<const NodeType*>(root));
+}
 
-    if(lchild) 
+/**
+* Walks from a node whose subtree just grew or shrank up towards the root,
+* updating heights and rebalancing where needed. Stops as soon as a subtree
+* ends up with the same height it had before, since nothing above it can
+* have changed. Counted nodes still need every ancestor's size refreshed,
+* so for them the walk carries on to the root doing just that. The root of
+* the tree, or of the detached subtree being worked on, is kept in top.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::retrace(NodeType* root, Node<Key, Value>*& top)
+{
+    while(root) 
     {
-        if(!lchild->getLeft() && !rchild->getRight()) {
-            lchild->setHeight(1);
-        } else {
+        int old_height = root->getHeight();
+        updateHeight(root);
+        updateCount(root);
 
-            if(lchild->getLeft()) {
-                leftHeight = lchild->getLeft()->getHeight();
-            }
-            if(lchild->getRight()) {
-                rightHeight = lchild->getRight()->getHeight();
+        if(returnBalanced(root)) 
+        {
+            root = rebalanceNode(root, top);
+        }
+        if(root->getHeight() == old_height) 
+        {
+            if(kCounted) 
+            {
+                for(root = root->getParent(); root; root = root->getParent()) 
+                {
+                    updateCount(root);
+                }
             }
-            lchild->setHeight(std::max(rightHeight, leftHeight));
+            return;
         }
+        root = root->getParent();
     }
+}
 
-    rightHeight = 0;
-    leftHeight = 0;
+/** 
+* Algorithm that decides which way to rotate an unbalanced tree.
+* Also updates the heights after rebalancing in constant time and
+* returns the node now at the top of the rotated subtree.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::rebalanceNode(NodeType* root, Node<Key, Value>*& top) {
+
+    NodeType* parent = root;
+    NodeType* firstChild;
 
-    if(rchild) 
+    if(heightOf(root->getRight()) > heightOf(root->getLeft())) 
     {
-        if(!rchild->getLeft() && !rchild->getRight()) 
+        firstChild = root->getRight();
+
+        if(heightOf(firstChild->getLeft()) > heightOf(firstChild->getRight())) 
         {
-            rchild->setHeight(1);
+            this->rightRotate(firstChild, top);
+            updateHeight(firstChild);
+            updateHeight(firstChild->getParent());
+        }
+        this->leftRotate(parent, top);
 
-        } else {
+    } else {
 
-            if(rchild->getLeft()) 
-            {
-                leftHeight = rchild->getLeft()->getHeight();
-            }
-            if(rchild->getRight()) 
-            {
-                rightHeight = rchild->getRight()->getHeight();
-            }
+        firstChild = root->getLeft();
 
-            rchild->setHeight(std::max(rightHeight, leftHeight));
+        if(heightOf(firstChild->getRight()) > heightOf(firstChild->getLeft())) 
+        {
+            this->leftRotate(firstChild, top);
+            updateHeight(firstChild);
+            updateHeight(firstChild->getParent());
         }
+        this->rightRotate(parent, top);
     }
 
-    if(lchild && rchild) 
-    {
-        root->setHeight(std::max(rchild->getHeight(), lchild->getHeight()));
-
-    } else if(lchild) {
-
-        root->setHeight(lchild->getHeight());
+    updateHeight(parent);
+    updateHeight(parent->getParent());
+    return parent->getParent();
+}
 
-    } else if(rchild) {
+/**
+* Function that recomputes the height of a node from its children.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::updateHeight(NodeType* root) {
 
-        root->setHeight(rchild->getHeight());
+    root->setHeight(std::max(heightOf(root->getLeft()), heightOf(root->getRight())) + 1);
+}
 
-    } else {
+/**
+* Returns the height stored at a node, treating an empty subtree as height 0.
+*/
+template<typename Key, typename Value, typename NodeType>
+int AVLTree<Key, Value, NodeType>::heightOf(const NodeType* root) {
 
-        root->setHeight(1);
-    }
-    
+    return root ? root->getHeight() : 0;
 }
 
 /**
-* Remove function for a given key. Finds the node, reattaches pointers, and then balances when finished. 
+* Runs the linear validation pass from bst.h over the AVLNodes, which also 
+* checks each node's stored height.
 */
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, typename NodeType>
+TreeStats AVLTree<Key, Value, NodeType>::validate() const
 {
-   removeHelper(key, dynamic_cast<AVLNode<Key,Value>*>(this->mRoot));
+    return this->validateNodes(static_cast<NodeType*>(this->mRoot));
 }
 
 /**
-* Remove function that is recursievely called until it finds the node to remove.
-* Once it removes, it updates the heights at the given node and recursively updates
-* the heights going back up constantly checking for any imbalances and whether it
-* needs to call rebelance node.
+* Rebalances the tree perfectly, as rotateBST does, but rotating AVLNodes so
+* that their heights and any subtree sizes are brought up to date.
 */
-template<typename Key, typename Value>
-void AVLTree<Key, Value>::removeHelper(const Key& key, AVLNode<Key,Value>* root) {
-    
-    AVLNode<Key,Value>* to_remove = nullptr;
-    if(root == nullptr) {
-        return;
-    } else if(key < root->getKey()) {
-        removeHelper(key,root->getLeft());
-    } else if(key  > root->getKey()) {
-        removeHelper(key,root->getRight());
-    } else {
-        to_remove = root;
-    }
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::rebalance()
+{
+    this->template rebalanceNodes<NodeType>();
+}
 
-    if(!to_remove) return; 
+/**
+* Builds AVLNodes, with their heights, when the tree is assembled from sorted items.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::buildBalanced(std::vector<std::pair<Key, Value> >& items)
+{
+    int height = 0;
+    this->mRoot = this->template buildRange<NodeType>(items, 0, items.size(), nullptr, height);
+}
 
-    AVLNode<Key,Value>* parent = to_remove->getParent();
+/**
+* Returns the number of keys in the tree that are smaller than the given key.
+*/
+template<typename Key, typename Value, typename NodeType>
+std::size_t AVLTree<Key, Value, NodeType>::rank(const Key& key) const
+{
+    static_assert(kCounted, "rank() needs a counted node type such as CountedAVLNode");
 
-    if(!to_remove->getRight() && !to_remove->getLeft()) 
+    std::size_t smaller = 0;
+    NodeType* curr = static_cast<NodeType*>(this->mRoot);
+    while(curr) 
     {
-        if(this->mRoot == to_remove) 
+        if(curr->getKey() < key) 
         {
-            this->mRoot = nullptr;
+            smaller += subtreeSize(curr->getLeft()) + 1;
+            curr = curr->getRight();
 
-        } else {    
+        } else {
 
-            if(to_remove->getParent()->getLeft() == to_remove) 
-            {
-                to_remove->getParent()->setLeft(nullptr);
+            curr = curr->getLeft();
+        }
+    }
+    return smaller;
+}
 
-            } else {
+/**
+* Returns an iterator to the item with the given zero-based position in key
+* order, or the end iterator if the tree holds no more than that many items.
+*/
+template<typename Key, typename Value, typename NodeType>
+typename rotateBST<Key, Value>::iterator AVLTree<Key, Value, NodeType>::select(std::size_t index) const
+{
+    static_assert(kCounted, "select() needs a counted node type such as CountedAVLNode");
 
-                to_remove->getParent()->setRight(nullptr);
-            }
-        }
-        delete to_remove;
-    } 
-    else if(!to_remove->getRight()) 
+    NodeType* curr = static_cast<NodeType*>(this->mRoot);
+    while(curr) 
     {
-        if(parent == nullptr) 
+        std::size_t left = subtreeSize(curr->getLeft());
+        if(index < left) 
         {
-            AVLNode<Key,Value>* child = to_remove->getLeft();
-            to_remove->setLeft(nullptr);
-            this->mRoot = child;
-            child->setParent(nullptr);
-            
-        }
-        else if(parent->getLeft() == to_remove) 
+            curr = curr->getLeft();
+        } 
+        else if(index > left) 
         {
-            parent->setLeft(to_remove->getLeft());
-            parent->getLeft()->setParent(parent);
-
-        } else {
-
-            parent->setRight(to_remove->getLeft());
-            parent->getRight()->setParent(parent);
+            index -= left + 1;
+            curr = curr->getRight();
+        } 
+        else 
+        {
+            break;
         }
+    }
+    return typename rotateBST<Key, Value>::iterator(curr, this);
+}
 
-        delete to_remove;
-    } 
-    else if(!to_remove->getLeft()) 
+/**
+* Returns the number of keys k in the tree with low <= k < high.
+*/
+template<typename Key, typename Value, typename NodeType>
+std::size_t AVLTree<Key, Value, NodeType>::countRange(const Key& low, const Key& high) const
+{
+    if(!(low < high)) 
     {
-        if(parent == nullptr) 
-        {
-            AVLNode<Key,Value>* child = to_remove->getRight();
-            to_remove->setRight(nullptr);
-            this->mRoot = child;
-            child->setParent(nullptr);
+        return 0;
+    }
+    return rank(high) - rank(low);
+}
 
-        } else {
+/**
+* Remove function for a given key. Finds the node, reattaches pointers, and then balances when finished. 
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::remove(const Key& key)
+{
+    removeHelper(static_cast<NodeType*>(this->internalFind(key)));
+}
 
-            if(parent->getLeft() == to_remove) 
-            {
-                parent->setLeft(to_remove->getRight());
-                parent->getLeft()->setParent(parent);
+/**
+* Removes a node already found, as pop_min(), extract() and erase() in
+* bst.h do, retracing from its parent just as remove() does.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::removeNode(Node<Key, Value>* node)
+{
+    removeHelper(static_cast<NodeType*>(node));
+}
 
-            } else {
+/**
+* Unlinks a node from the tree. A node with two children is first swapped 
+* with its predecessor so that it has at most one child, which then takes
+* its place. The heights are retraced from the removed node's parent.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::removeHelper(NodeType* to_remove) {
 
-                parent->setRight(to_remove->getRight());
-                parent->getRight()->setParent(parent);  
-            }
-        }
+    if(to_remove == nullptr) {
+        return;
+    }
 
-        delete to_remove;
+    if(to_remove->getLeft() && to_remove->getRight()) 
+    {
+        swapPred(to_remove, getPredecessor(to_remove));
+    }
+    this->trackDetaching(to_remove);
 
-    } else {
+    NodeType* parent = to_remove->getParent();
+    NodeType* child = to_remove->getLeft() ? to_remove->getLeft() : to_remove->getRight();
 
-        AVLNode<Key,Value>* predecessor = getPredecessor(to_remove);
-        swapPred(to_remove, predecessor);
-        removeHelper(key, to_remove);
+    if(child) 
+    {
+        child->setParent(parent);
     }
 
-    if(parent) {
-        if(parent->getRight() && parent->getLeft()) {
-            parent->setHeight((std::max(parent->getRight()->getHeight(), parent->getLeft()->getHeight()))+1);
-        } else if(parent->getRight()) {
-            parent->setHeight(parent->getRight()->getHeight() + 1);
-        } else if(parent->getLeft()) {
-            parent->setHeight(parent->getLeft()->getHeight() + 1);
-        }
+    if(parent == nullptr) 
+    {
+        this->mRoot = child;
 
-        bool unbalanced = returnBalanced(parent);
-        if(unbalanced) {
-            rebalanceNode(parent);
-        }
+    } else if(parent->getLeft() == to_remove) {
+
+        parent->setLeft(child);
+
+    } else {
+
+        parent->setRight(child);
     }
-}
 
+    this->destroyNode(to_remove);
+    retrace(parent, this->mRoot);
+}
 
-template<typename Key, typename Value>
-AVLNode<Key, Value>* AVLTree<Key, Value>::getPredecessor(AVLNode<Key,Value>* root) {
-    AVLNode<Key,Value>* temp = root->getLeft();
+/** 
+ * Function that returns the predecessor of a given node.
+ */
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::getPredecessor(NodeType* root) {
+    NodeType* temp = root->getLeft();
     if(temp == nullptr) {
         return nullptr;
     }
@@ -514,8 +762,11 @@ AVLNode<Key, Value>* AVLTree<Key, Value>::getPredecessor(AVLNode<Key,Value>* roo
     return temp;
 }
 
-template<typename Key, typename Value>
-void AVLTree<Key,Value>::swapPred(AVLNode<Key,Value>* remove , AVLNode<Key,Value>* pred)
+/** 
+ * Swaps a node with it's predecessor, along with their heights and sizes.
+ */
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::swapPred(NodeType* remove , NodeType* pred)
 {
 
     bool root = false;
@@ -584,10 +835,19 @@ void AVLTree<Key,Value>::swapPred(AVLNode<Key,Value>* remove , AVLNode<Key,Value
     {
         this->mRoot = pred;
     } 
+
+    int height = pred->getHeight();
+    pred->setHeight(remove->getHeight());
+    remove->setHeight(height);
+    updateCount(remove);
+    updateCount(pred);
 } 
 
-template<typename Key, typename Value>
-bool AVLTree<Key, Value>::returnBalanced(AVLNode<Key,Value>* root) const
+/**
+ * Returns true iff the heights of a node's children differ by more than one.
+ */
+template<typename Key, typename Value, typename NodeType>
+bool AVLTree<Key, Value, NodeType>::returnBalanced(NodeType* root) const
 {
     if(root->getRight() && root->getLeft()) 
     {
@@ -610,6 +870,549 @@ bool AVLTree<Key, Value>::returnBalanced(AVLNode<Key,Value>* root) const
     return false;
 }
 
+/**
+* Adds every item of the other tree, replacing the value of keys already
+* present. Each node of the other tree is reused, either straight from its
+* allocator if this tree can take that over or else from a copy.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::union_with(AVLTree other)
+{
+    std::size_t total = addSizes(this->mSize, other.mSize);
+    std::vector<Node<Key, Value>*> discarded;
+    NodeType* root = static_cast<NodeType*>(this->mRoot);
+    this->mRoot = unionNodes(root, adoptNodes(other), discarded, forkDepth());
+    this->resetBounds(subtractSize(total, destroyAll(discarded)));
+}
+
+/**
+* Removes every item whose key is not also in the other tree.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::intersect_with(const AVLTree& other)
+{
+    if(this == &other)
+    {
+        return;
+    }
+    std::vector<Node<Key, Value>*> discarded;
+    NodeType* root = static_cast<NodeType*>(this->mRoot);
+    this->mRoot = intersectNodes(root, static_cast<const NodeType*>(other.mRoot), discarded, forkDepth());
+    this->resetBounds(subtractSize(this->mSize, destroyAll(discarded)));
+}
+
+/**
+* Removes every item whose key is in the other tree.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::difference(const AVLTree& other)
+{
+    if(this == &other)
+    {
+        this->clear();
+        return;
+    }
+    std::vector<Node<Key, Value>*> discarded;
+    NodeType* root = static_cast<NodeType*>(this->mRoot);
+    this->mRoot = differenceNodes(root, static_cast<const NodeType*>(other.mRoot), discarded, forkDepth());
+    this->resetBounds(subtractSize(this->mSize, destroyAll(discarded)));
+}
+
+/**
+* Moves every item with a key not less than the given one into a new tree,
+* which is returned. The new tree shares this tree's allocator, as its
+* nodes still live there. Only counted nodes tell how many items went
+* each way, so for other node types both sizes are left to be counted
+* when first asked for.
+*/
+template<typename Key, typename Value, typename NodeType>
+AVLTree<Key, Value, NodeType> AVLTree<Key, Value, NodeType>::split(const Key& key)
+{
+    AVLTree upper(this->mAllocator);
+    NodeType* less;
+    NodeType* match;
+    NodeType* greater;
+    split(static_cast<NodeType*>(this->mRoot), key, less, match, greater);
+    if(match) 
+    {
+        greater = join(nullptr, match, greater);
+    }
+    std::size_t lower = this->kUnknownSize;
+    std::size_t higher = this->kUnknownSize;
+    storedSize(less, lower);
+    storedSize(greater, higher);
+    this->mRoot = less;
+    this->resetBounds(lower);
+    upper.mRoot = greater;
+    upper.resetBounds(higher);
+    return upper;
+}
+
+/**
+* Appends the items of the other tree, all of whose keys should be greater
+* than those here, as in a tree split off by split(). The two are joined
+* in O(log n); if the key ranges overlap after all, the other tree is
+* merged in by union_with instead.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::concat(AVLTree other)
+{
+    std::size_t total = addSizes(this->mSize, other.mSize);
+    NodeType* left = static_cast<NodeType*>(this->mRoot);
+    NodeType* right = adoptNodes(other);
+    if(left == nullptr || right == nullptr) 
+    {
+        this->mRoot = left ? left : right;
+        this->resetBounds(total);
+        return;
+    }
+
+    NodeType* first = right;
+    while(first->getLeft()) 
+    {
+        first = first->getLeft();
+    }
+    if(this->getLargestNode()->getKey() < first->getKey()) 
+    {
+        this->mRoot = join2(left, right);
+        this->resetBounds(total);
+        return;
+    }
+
+    std::vector<Node<Key, Value>*> discarded;
+    this->mRoot = unionNodes(left, right, discarded, forkDepth());
+    this->resetBounds(subtractSize(total, destroyAll(discarded)));
+}
+
+/**
+* Inserts every item in [first, last). The batch is sorted and then merged
+* into the tree by insertSorted(), which visits each node only once for
+* all of the keys below it and leaves rebalancing to the joins on the way
+* back up, so k items go into a tree of n in O(k log(n/k + 1)) time.
+*/
+template<typename Key, typename Value, typename NodeType>
+template<typename InputIterator>
+void AVLTree<Key, Value, NodeType>::insert_batch(InputIterator first, InputIterator last)
+{
+    std::vector<std::pair<Key, Value> > items(first, last);
+    std::stable_sort(items.begin(), items.end(), 
+        [](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return a.first < b.first; });
+    this->keepLastOfEachKey(items);
+
+    std::size_t added = 0;
+    this->mRoot = insertSorted(static_cast<NodeType*>(this->mRoot), items, 0, items.size(), added);
+    this->resetBounds(addSizes(this->mSize, added));
+}
+
+/**
+* Erases every key in [first, last) that is present, sorting the keys and
+* merging them against the tree as insert_batch() does.
+*/
+template<typename Key, typename Value, typename NodeType>
+template<typename InputIterator>
+void AVLTree<Key, Value, NodeType>::erase_batch(InputIterator first, InputIterator last)
+{
+    std::vector<Key> keys(first, last);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end(), 
+        [](const Key& a, const Key& b) { return !(a < b) && !(b < a); }), keys.end());
+
+    std::size_t removed = 0;
+    this->mRoot = eraseSorted(static_cast<NodeType*>(this->mRoot), keys, 0, keys.size(), removed);
+    this->resetBounds(subtractSize(this->mSize, removed));
+}
+
+/**
+* Merges the sorted, distinct items[first, last) into a detached subtree and
+* returns its new root. The items are split around the root's key with a
+* binary search, each half goes into the matching child, and the root then
+* joins the two results, which restores the balance of everything below.
+* Items that reach an empty subtree are built into a balanced one directly.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::insertSorted(NodeType* root, std::vector<std::pair<Key, Value> >& items,
+    std::size_t first, std::size_t last, std::size_t& added)
+{
+    if(first == last) 
+    {
+        return root;
+    }
+    if(root == nullptr) 
+    {
+        int height = 0;
+        added += last - first;
+        return this->template buildRange<NodeType>(items, first, last, nullptr, height);
+    }
+
+    std::size_t middle = std::lower_bound(items.begin() + first, items.begin() + last, root->getKey(),
+        [](const std::pair<Key, Value>& item, const Key& key) { return item.first < key; }) - items.begin();
+    std::size_t after = middle;
+    if(after < last && !(root->getKey() < items[after].first)) 
+    {
+        root->setValue(std::move(items[after].second));
+        ++after;
+    }
+
+    NodeType* left = insertSorted(detach(root->getLeft()), items, first, middle, added);
+    NodeType* right = insertSorted(detach(root->getRight()), items, after, last, added);
+    return join(left, root, right);
+}
+
+/**
+* Removes the nodes whose key is among the sorted, distinct keys[first, last)
+* from a detached subtree and returns its new root, in the same way as
+* insertSorted(). A removed root leaves its two results to be joined alone.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::eraseSorted(NodeType* root, const std::vector<Key>& keys,
+    std::size_t first, std::size_t last, std::size_t& removed)
+{
+    if(first == last || root == nullptr) 
+    {
+        return root;
+    }
+
+    std::size_t middle = std::lower_bound(keys.begin() + first, keys.begin() + last, root->getKey()) - keys.begin();
+    std::size_t after = middle;
+    bool found = after < last && !(root->getKey() < keys[after]);
+    if(found) 
+    {
+        ++after;
+    }
+
+    NodeType* left = eraseSorted(detach(root->getLeft()), keys, first, middle, removed);
+    NodeType* right = eraseSorted(detach(root->getRight()), keys, after, last, removed);
+    if(found) 
+    {
+        this->destroyNode(root);
+        ++removed;
+        return join2(left, right);
+    }
+    return join(left, root, right);
+}
+
+/**
+* Joins two subtrees and a node whose key lies between all of theirs into
+* one balanced subtree. The node goes in where the shorter subtree meets
+* the spine of the taller one, and the heights are retraced from there,
+* which takes time in the difference of the two heights.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::join(NodeType* left, NodeType* middle, NodeType* right)
+{
+    Node<Key, Value>* top = middle;
+    NodeType* parent = nullptr;
+
+    if(heightOf(left) > heightOf(right) + 1) 
+    {
+        top = left;
+        for(parent = left; heightOf(parent->getRight()) > heightOf(right) + 1; parent = parent->getRight()) { }
+        left = parent->getRight();
+        parent->setRight(middle);
+
+    } else if(heightOf(right) > heightOf(left) + 1) {
+
+        top = right;
+        for(parent = right; heightOf(parent->getLeft()) > heightOf(left) + 1; parent = parent->getLeft()) { }
+        right = parent->getLeft();
+        parent->setLeft(middle);
+    }
+
+    middle->setParent(parent);
+    middle->setLeft(left);
+    middle->setRight(right);
+    if(left) 
+    {
+        left->setParent(middle);
+    }
+    if(right) 
+    {
+        right->setParent(middle);
+    }
+    updateHeight(middle);
+    updateCount(middle);
+    retrace(parent, top);
+    return static_cast<NodeType*>(top);
+}
+
+/**
+* Joins two subtrees, every key of the left one smaller than every key of
+* the right one, by taking the largest node out of the left to join them.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::join2(NodeType* left, NodeType* right)
+{
+    if(left == nullptr || right == nullptr) 
+    {
+        return left ? left : right;
+    }
+
+    NodeType* last = left;
+    while(last->getRight()) 
+    {
+        last = last->getRight();
+    }
+
+    Node<Key, Value>* top = left;
+    NodeType* parent = last->getParent();
+    NodeType* child = last->getLeft();
+    if(child) 
+    {
+        child->setParent(parent);
+    }
+    if(parent) 
+    {
+        parent->setRight(child);
+
+    } else {
+
+        top = child;
+    }
+    retrace(parent, top);
+    return join(static_cast<NodeType*>(top), last, right);
+}
+
+/**
+* Splits a subtree into the subtrees of keys less and greater than the
+* given key, plus the node holding the key itself if there is one. The
+* path to the key is cut off piece by piece and the pieces on each side
+* are joined back together on the way up, in O(log n) overall.
+*/
+template<typename Key, typename Value, typename NodeType>
+void AVLTree<Key, Value, NodeType>::split(NodeType* root, const Key& key, NodeType*& less, NodeType*& match, NodeType*& greater)
+{
+    if(root == nullptr) 
+    {
+        less = match = greater = nullptr;
+        return;
+    }
+
+    NodeType* left = detach(root->getLeft());
+    NodeType* right = detach(root->getRight());
+    if(key < root->getKey()) 
+    {
+        split(left, key, less, match, greater);
+        greater = join(greater, root, right);
+
+    } else if(root->getKey() < key) {
+
+        split(right, key, less, match, greater);
+        less = join(left, root, less);
+
+    } else {
+
+        root->setLeft(nullptr);
+        root->setRight(nullptr);
+        less = left;
+        match = root;
+        greater = right;
+    }
+}
+
+/**
+* Merges subtree b into subtree a: a is split around the root of b, the
+* halves are merged with the children of b, and the root of b joins the
+* results. Nodes of a whose key turns up in b are left in discarded.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::unionNodes(NodeType* a, NodeType* b, std::vector<Node<Key, Value>*>& discarded, int forks)
+{
+    if(a == nullptr || b == nullptr) 
+    {
+        return a ? a : b;
+    }
+
+    bool fork = forks > 0 && std::min(heightOf(a), heightOf(b)) >= kForkHeight;
+    NodeType* bLeft = detach(b->getLeft());
+    NodeType* bRight = detach(b->getRight());
+    NodeType* aLeft;
+    NodeType* aMatch;
+    NodeType* aRight;
+    split(a, b->getKey(), aLeft, aMatch, aRight);
+    if(aMatch) 
+    {
+        discarded.push_back(aMatch);
+    }
+
+    NodeType* left;
+    NodeType* right;
+    bothSides(fork, [&](bool leftSide, std::vector<Node<Key, Value>*>& out) {
+        return leftSide ? unionNodes(aLeft, bLeft, out, forks - 1) : unionNodes(aRight, bRight, out, forks - 1);
+    }, left, right, discarded);
+    return join(left, b, right);
+}
+
+/**
+* Keeps the nodes of subtree a whose key is also in subtree b, which is
+* only read. Everything else of a is left in discarded.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::intersectNodes(NodeType* a, const NodeType* b, std::vector<Node<Key, Value>*>& discarded, int forks)
+{
+    if(a == nullptr || b == nullptr) 
+    {
+        if(a) 
+        {
+            discarded.push_back(a);
+        }
+        return nullptr;
+    }
+
+    bool fork = forks > 0 && std::min(heightOf(a), heightOf(b)) >= kForkHeight;
+    NodeType* aLeft;
+    NodeType* aMatch;
+    NodeType* aRight;
+    split(a, b->getKey(), aLeft, aMatch, aRight);
+
+    NodeType* left;
+    NodeType* right;
+    bothSides(fork, [&](bool leftSide, std::vector<Node<Key, Value>*>& out) {
+        return leftSide ? intersectNodes(aLeft, b->getLeft(), out, forks - 1) : intersectNodes(aRight, b->getRight(), out, forks - 1);
+    }, left, right, discarded);
+    return aMatch ? join(left, aMatch, right) : join2(left, right);
+}
+
+/**
+* Keeps the nodes of subtree a whose key is not in subtree b, which is
+* only read. The others are left in discarded.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::differenceNodes(NodeType* a, const NodeType* b, std::vector<Node<Key, Value>*>& discarded, int forks)
+{
+    if(a == nullptr || b == nullptr) 
+    {
+        return a;
+    }
+
+    bool fork = forks > 0 && std::min(heightOf(a), heightOf(b)) >= kForkHeight;
+    NodeType* aLeft;
+    NodeType* aMatch;
+    NodeType* aRight;
+    split(a, b->getKey(), aLeft, aMatch, aRight);
+    if(aMatch) 
+    {
+        discarded.push_back(aMatch);
+    }
+
+    NodeType* left;
+    NodeType* right;
+    bothSides(fork, [&](bool leftSide, std::vector<Node<Key, Value>*>& out) {
+        return leftSide ? differenceNodes(aLeft, b->getLeft(), out, forks - 1) : differenceNodes(aRight, b->getRight(), out, forks - 1);
+    }, left, right, discarded);
+    return join2(left, right);
+}
+
+/**
+* Runs the two halves of a set operation, the left half on a thread of its
+* own if fork is set. The halves work on disjoint subtrees, and neither
+* allocates nor frees nodes, so they share nothing but the discarded list,
+* of which the left half gets a separate one until it is done.
+*/
+template<typename Key, typename Value, typename NodeType>
+template<typename Branch>
+void AVLTree<Key, Value, NodeType>::bothSides(bool fork, const Branch& branch, NodeType*& left, NodeType*& right,
+    std::vector<Node<Key, Value>*>& discarded)
+{
+    if(!fork) 
+    {
+        left = branch(true, discarded);
+        right = branch(false, discarded);
+        return;
+    }
+
+    std::vector<Node<Key, Value>*> leftDiscarded;
+    std::future<NodeType*> leftTask = std::async(std::launch::async, [&]() { return branch(true, leftDiscarded); });
+    right = branch(false, discarded);
+    left = leftTask.get();
+    discarded.insert(discarded.end(), leftDiscarded.begin(), leftDiscarded.end());
+}
+
+/**
+* Empties the other tree and returns its nodes in a form this tree can own:
+* as they are if both trees draw from the same allocator or this one can
+* absorb the other's, and as a copy from this tree's allocator otherwise.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::adoptNodes(AVLTree& other)
+{
+    Node<Key, Value>* root = other.mRoot;
+    if(root && this->mAllocator != other.mAllocator 
+        && !(other.mAllocator.use_count() == 1 && this->mAllocator->absorb(*other.mAllocator))) 
+    {
+        root = cloneRoot(root);
+        other.clear();
+    }
+    other.mRoot = nullptr;
+    other.resetBounds(0);
+    return static_cast<NodeType*>(root);
+}
+
+/**
+* Frees the nodes and detached subtrees a set operation left over and
+* returns how many nodes that was.
+*/
+template<typename Key, typename Value, typename NodeType>
+std::size_t AVLTree<Key, Value, NodeType>::destroyAll(const std::vector<Node<Key, Value>*>& discarded)
+{
+    std::size_t count = 0;
+    for(std::size_t i = 0; i < discarded.size(); ++i) 
+    {
+        count += this->helpClear(discarded[i]);
+    }
+    return count;
+}
+
+/**
+* Adds two tree sizes, either of which may be unknown.
+*/
+template<typename Key, typename Value, typename NodeType>
+std::size_t AVLTree<Key, Value, NodeType>::addSizes(std::size_t a, std::size_t b)
+{
+    if(a == AVLTree::kUnknownSize || b == AVLTree::kUnknownSize) 
+    {
+        return AVLTree::kUnknownSize;
+    }
+    return a + b;
+}
+
+/**
+* Takes the number of freed nodes off a tree size, which may be unknown.
+*/
+template<typename Key, typename Value, typename NodeType>
+std::size_t AVLTree<Key, Value, NodeType>::subtractSize(std::size_t size, std::size_t freed)
+{
+    return size == AVLTree::kUnknownSize ? size : size - freed;
+}
+
+/**
+* Cuts a subtree loose from its parent and returns it.
+*/
+template<typename Key, typename Value, typename NodeType>
+NodeType* AVLTree<Key, Value, NodeType>::detach(NodeType* root)
+{
+    if(root) 
+    {
+        root->setParent(nullptr);
+    }
+    return root;
+}
+
+/**
+* Returns how many levels of a set operation may fork, enough to give
+* every hardware thread a share of the work.
+*/
+template<typename Key, typename Value, typename NodeType>
+int AVLTree<Key, Value, NodeType>::forkDepth()
+{
+    unsigned threads = std::thread::hardware_concurrency();
+    int depth = 0;
+    while((1u << depth) < threads) 
+    {
+        ++depth;
+    }
+    return depth;
+}
+
 /*
 ------------------------------------------
 End implementations for the AVLTree class.
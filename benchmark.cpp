@@ -0,0 +1,952 @@
+#include "avlbst.h"
+#include "bplustree.h"
+#include "compactavl.h"
+#include "concurrentavl.h"
+#include "persistentavl.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+	Benchmark suite for the search trees in this directory.
+
+	Each tree, key distribution and size combination runs in its own forked
+	child process, so the peak RSS reported for it belongs to that case
+	alone. The child builds one tree and runs these workloads on it in order:
+
+		insert       insert the n keys in distribution order
+		lookup_hit   find n keys that are present
+		lookup_miss  find n keys that are absent
+		iterate      walk the whole tree in order
+		mixed        n operations: 80% find, 10% insert, 10% erase
+		rank         rank() queries (avl_ordered only)
+		erase        erase the n keys in distribution order
+
+	The trees are bst, rotate, avl, avl_heap (AVLTree on the global heap),
+	avl_ordered, avl_frozen (a freeze() snapshot of an AVLTree, which only
+	runs insert, freeze, the lookups and iterate), avl_persistent
+	(PersistentAVLTree, with path copying on every write), avl_compact
+	(CompactAVLTree, with one byte balance factors and 32 bit index
+	links), bplus, avl64, avl64_compact and bplus64 (64 bit keys),
+	bplus64_scalar (bplus64 with the vector node search turned off) and
+	std::map.
+
+	Two more trees, avl_concurrent (ConcurrentAVLTree) and avl_mutex (an
+	AVLTree behind one mutex), are not run by default. Instead of the
+	workloads above they run a 95% find / 5% write mix from each of the
+	--threads counts in turn, reported as mixed95_t<threads>. These rows
+	only show read scaling on a machine with at least as many cores as
+	threads; beyond that the threads take turns on the cores, and a
+	warning naming the core count goes to stderr.
+
+	avl_setops is not run by default either. It times union_with,
+	intersect_with and difference of the n keys with n / 2 others, half of
+	them shared, once each, against a loop of inserts for the union, and
+	split and concat of the n keys at their middle, against moving the
+	upper half over one item at a time.
+
+	avl_queue is not run by default. It empties a tree of the n keys from
+	the smallest up, once by pop_min() and once by looking up the smallest
+	key and calling remove() on it, as a priority queue would without
+	pop_min().
+
+	avl_hint is not run by default. It inserts the n keys into an AVLTree
+	once with plain inserts, which take the append path when a key is
+	beyond the largest, and once with each insert hinted by the iterator
+	the previous one returned. Its natural distributions are sorted and
+	nearly_sorted, the sorted keys with each run of 16 shuffled, which is
+	not run by default either.
+
+	avl_batch is not run by default. After inserting the n keys it adds n
+	absent keys in batches of 10000, once by a loop of insert() and once
+	by insert_batch(), and then takes them out again by a loop of remove()
+	and by erase_batch(). Its rows count batches, not keys.
+
+	Results go to stdout as CSV, one row per workload:
+
+		tree,distribution,n,workload,ops,ops_per_sec,p50_ns,p99_ns,peak_rss_kb
+
+	Usage: benchmark [--sizes 1000,50000000] [--trees avl,map] [--dists zipf]
+	                 [--threads 1,2,4,8,16,32] [--unbalanced-limit 100000]
+
+	The unbalanced trees go quadratic on sorted and reverse input, so those
+	combinations are skipped above --unbalanced-limit keys.
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+* Draws ranks 1..n with probability proportional to 1/rank^s using
+* rejection-inversion sampling, which needs O(1) memory for any n.
+*/
+class ZipfSampler
+{
+public:
+	ZipfSampler(size_t n, double s)
+		: mN(static_cast<double>(n))
+		, mS(s)
+	{
+		mIntegralX1 = hIntegral(1.5) - 1.0;
+		mIntegralN = hIntegral(mN + 0.5);
+		mCutoff = 2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0));
+	}
+
+	template<typename Rng>
+	size_t operator()(Rng& rng)
+	{
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		while(true)
+		{
+			double u = mIntegralN + uniform(rng) * (mIntegralX1 - mIntegralN);
+			double x = hIntegralInverse(u);
+			double k = std::floor(x + 0.5);
+			k = std::min(std::max(k, 1.0), mN);
+			if(k - x <= mCutoff || u >= hIntegral(k + 0.5) - h(k))
+			{
+				return static_cast<size_t>(k);
+			}
+		}
+	}
+
+private:
+	double h(double x) const
+	{
+		return std::exp(-mS * std::log(x));
+	}
+
+	double hIntegral(double x) const
+	{
+		double logX = std::log(x);
+		return helper2((1.0 - mS) * logX) * logX;
+	}
+
+	double hIntegralInverse(double x) const
+	{
+		double t = std::max(x * (1.0 - mS), -1.0);
+		return std::exp(helper1(t) * x);
+	}
+
+	static double helper1(double x)
+	{
+		return std::fabs(x) > 1e-8 ? std::log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+	}
+
+	static double helper2(double x)
+	{
+		return std::fabs(x) > 1e-8 ? std::expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+	}
+
+	double mN;
+	double mS;
+	double mIntegralX1;
+	double mIntegralN;
+	double mCutoff;
+};
+
+/*
+	Adapters giving the trees and std::map the same operations.
+*/
+
+template<typename Tree>
+static void insertKey(Tree& tree, int key)
+{
+	tree.insert(std::make_pair(key, key));
+}
+
+static void insertKey(std::map<int, int>& tree, int key)
+{
+	tree[key] = key;
+}
+
+template<typename Tree>
+static bool findKey(Tree& tree, int key)
+{
+	return tree.find(key) != tree.end();
+}
+
+template<typename Tree>
+static void eraseKey(Tree& tree, int key)
+{
+	tree.remove(key);
+}
+
+static void eraseKey(std::map<int, int>& tree, int key)
+{
+	tree.erase(key);
+}
+
+template<typename Tree>
+static size_t rankKey(const Tree&, int)
+{
+	return 0;
+}
+
+static size_t rankKey(const OrderedAVLTree<int, int>& tree, int key)
+{
+	return tree.rank(key);
+}
+
+/**
+* Times workloads for one case. Every stride-th operation is timed on its
+* own for the latency percentiles, and the runs of operations between
+* those are timed as a block for the throughput, so that the clock reads
+* around the samples do not count towards it.
+*/
+class Workload
+{
+public:
+	Workload(const char* tree, const char* dist, size_t n)
+		: mTree(tree)
+		, mDist(dist)
+		, mN(n)
+	{
+
+	}
+
+	template<typename Op>
+	void run(const char* name, size_t ops, Op op)
+	{
+		// Sample at most a million operations, and never more than one in
+		// 16 so that each block is long enough to hide its two clock reads.
+		size_t stride = std::max<size_t>(16, ops / 1000000);
+
+		std::vector<double> samples;
+		samples.reserve(ops / stride + 1);
+
+		double blockSecs = 0.0;
+		size_t blockOps = 0;
+		for(size_t i = 0; i < ops; )
+		{
+			Clock::time_point before = Clock::now();
+			op(i);
+			samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - before).count());
+			++i;
+
+			size_t end = std::min(ops, i + stride - 1);
+			if(i < end)
+			{
+				blockOps += end - i;
+				Clock::time_point start = Clock::now();
+				for(; i < end; ++i)
+				{
+					op(i);
+				}
+				blockSecs += std::chrono::duration<double>(Clock::now() - start).count();
+			}
+		}
+
+		// Too few operations for a block leaves only the samples to go by.
+		double secs = 0.0;
+		if(blockOps > 0)
+		{
+			secs = blockSecs * ops / blockOps;
+
+		} else {
+
+			for(size_t i = 0; i < samples.size(); ++i)
+			{
+				secs += samples[i] * 1e-9;
+			}
+		}
+		report(name, ops, secs, samples);
+	}
+
+	/**
+	* Prints the row for a workload given its wall time and latency samples.
+	*/
+	void report(const char* name, size_t ops, double secs, std::vector<double>& samples)
+	{
+		double p50 = 0.0;
+		double p99 = 0.0;
+		if(!samples.empty())
+		{
+			std::sort(samples.begin(), samples.end());
+			p50 = samples[samples.size() / 2];
+			p99 = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+		}
+
+		struct rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+
+		std::printf("%s,%s,%zu,%s,%zu,%.0f,%.1f,%.1f,%ld\n", mTree, mDist, mN, name, ops,
+			secs > 0 ? ops / secs : 0.0, p50, p99, usage.ru_maxrss);
+		std::fflush(stdout);
+	}
+
+private:
+	const char* mTree;
+	const char* mDist;
+	size_t mN;
+};
+
+/**
+* The keys a case inserts, in insertion order, the order they are looked
+* up in, and keys known to be absent. Present keys are even, absent odd.
+*/
+struct KeySet
+{
+	std::vector<int> order;
+	std::vector<int> probes;
+	std::vector<int> misses;
+};
+
+static KeySet makeKeys(const std::string& dist, size_t n)
+{
+	KeySet keys;
+	std::mt19937 rng(42);
+
+	keys.order.resize(n);
+	for(size_t i = 0; i < n; ++i)
+	{
+		keys.order[i] = static_cast<int>(2 * i);
+	}
+
+	if(dist == "reverse")
+	{
+		std::reverse(keys.order.begin(), keys.order.end());
+	}
+	else if(dist == "random")
+	{
+		std::shuffle(keys.order.begin(), keys.order.end(), rng);
+	}
+	else if(dist == "nearly_sorted")
+	{
+		for(size_t i = 0; i < n; i += 16)
+		{
+			std::shuffle(keys.order.begin() + i, keys.order.begin() + std::min(n, i + 16), rng);
+		}
+	}
+	else if(dist == "zipf")
+	{
+		// Popular keys are spread over the key space rather than clustered
+		// at the low end, and repeats turn inserts into updates.
+		std::vector<int> byRank(keys.order);
+		std::shuffle(byRank.begin(), byRank.end(), rng);
+		ZipfSampler zipf(n, 0.99);
+		for(size_t i = 0; i < n; ++i)
+		{
+			keys.order[i] = byRank[zipf(rng) - 1];
+		}
+	}
+
+	keys.probes = keys.order;
+	if(dist == "random")
+	{
+		std::shuffle(keys.probes.begin(), keys.probes.end(), rng);
+	}
+
+	keys.misses.resize(n);
+	for(size_t i = 0; i < n; ++i)
+	{
+		keys.misses[i] = keys.probes[i] + 1;
+	}
+	return keys;
+}
+
+/**
+* Runs every workload in turn against one tree and prints a row for each.
+*/
+template<typename Tree>
+static void runWorkloads(Tree& tree, const char* name, const std::string& dist, size_t n)
+{
+	KeySet keys = makeKeys(dist, n);
+	Workload work(name, dist.c_str(), n);
+	long long checksum = 0;
+
+	work.run("insert", n, [&](size_t i) { insertKey(tree, keys.order[i]); });
+	work.run("lookup_hit", n, [&](size_t i) { checksum += findKey(tree, keys.probes[i]); });
+	work.run("lookup_miss", n, [&](size_t i) { checksum += findKey(tree, keys.misses[i]); });
+
+	size_t items = std::distance(tree.begin(), tree.end());
+	typename Tree::const_iterator it = tree.begin();
+	work.run("iterate", items, [&](size_t) { checksum += it->second; ++it; });
+
+	std::mt19937 rng(7);
+	std::vector<unsigned char> choices(n);
+	for(size_t i = 0; i < n; ++i)
+	{
+		choices[i] = static_cast<unsigned char>(rng() % 10);
+	}
+	work.run("mixed", n, [&](size_t i) {
+		if(choices[i] < 8)
+		{
+			checksum += findKey(tree, keys.probes[i]);
+		}
+		else if(choices[i] == 8)
+		{
+			eraseKey(tree, keys.probes[i]);
+		}
+		else
+		{
+			insertKey(tree, keys.misses[i]);
+		}
+	});
+
+	if(std::strcmp(name, "avl_ordered") == 0)
+	{
+		work.run("rank", n, [&](size_t i) { checksum += rankKey(tree, keys.probes[i]); });
+	}
+
+	work.run("erase", n, [&](size_t i) { eraseKey(tree, keys.order[i]); });
+
+	// Keeps the lookups from being optimised away.
+	if(checksum == -1)
+	{
+		std::fprintf(stderr, "checksum %lld\n", checksum);
+	}
+}
+
+/**
+* The read-only counterpart of runWorkloads: builds an AVLTree, times
+* freezing it, and runs the lookup and iteration workloads on the snapshot.
+*/
+static void runFrozenWorkloads(const std::string& dist, size_t n)
+{
+	KeySet keys = makeKeys(dist, n);
+	Workload work("avl_frozen", dist.c_str(), n);
+	long long checksum = 0;
+
+	AVLTree<int, int> tree;
+	work.run("insert", n, [&](size_t i) { insertKey(tree, keys.order[i]); });
+
+	FrozenTree<int, int> frozen;
+	work.run("freeze", 1, [&](size_t) { frozen = tree.freeze(); });
+	tree.clear();
+
+	work.run("lookup_hit", n, [&](size_t i) { checksum += findKey(frozen, keys.probes[i]); });
+	work.run("lookup_miss", n, [&](size_t i) { checksum += findKey(frozen, keys.misses[i]); });
+
+	FrozenTree<int, int>::iterator it = frozen.begin();
+	work.run("iterate", frozen.size(), [&](size_t) { checksum += it->second; ++it; });
+
+	if(checksum == -1)
+	{
+		std::fprintf(stderr, "checksum %lld\n", checksum);
+	}
+}
+
+/**
+* Times the AVLTree set operations between a tree of the n keys and one of
+* n / 2 keys, half of them present in the first tree and half absent, with
+* a loop of single inserts as the baseline for the union.
+*/
+static void runSetWorkloads(const std::string& dist, size_t n)
+{
+	KeySet keys = makeKeys(dist, n);
+	Workload work("avl_setops", dist.c_str(), n);
+
+	AVLTree<int, int> big;
+	AVLTree<int, int> small;
+	for(size_t i = 0; i < n; ++i)
+	{
+		insertKey(big, keys.order[i]);
+	}
+	for(size_t i = 0; i < n / 2; ++i)
+	{
+		insertKey(small, i % 2 ? keys.probes[i] : keys.misses[i]);
+	}
+
+	AVLTree<int, int> a(big);
+	work.run("union_loop", 1, [&](size_t) {
+		for(AVLTree<int, int>::const_iterator it = small.cbegin(); it != small.cend(); ++it)
+		{
+			a.insert(*it);
+		}
+	});
+
+	a = big;
+	AVLTree<int, int> b(small);
+	work.run("union", 1, [&](size_t) { a.union_with(std::move(b)); });
+
+	a = big;
+	work.run("intersect", 1, [&](size_t) { a.intersect_with(small); });
+
+	a = big;
+	work.run("difference", 1, [&](size_t) { a.difference(small); });
+
+	// Moving the upper half of the keys into a tree of its own, item by
+	// item and then by split(), and putting it back with concat().
+	int middle = static_cast<int>(n);
+	a = big;
+	AVLTree<int, int> upper;
+	work.run("split_loop", 1, [&](size_t) {
+		for(AVLTree<int, int>::iterator it = a.lower_bound(middle); it != a.end(); ++it)
+		{
+			upper.insert(*it);
+		}
+		for(int key = middle; key < 2 * middle; key += 2)
+		{
+			a.remove(key);
+		}
+	});
+
+	a = big;
+	upper.clear();
+	work.run("split", 1, [&](size_t) { upper = a.split(middle); });
+	work.run("concat", 1, [&](size_t) { a.concat(std::move(upper)); });
+}
+
+/**
+* Times draining an AVLTree in key order through pop_min() against
+* remove() of the smallest key, which searches for it again from the root.
+*/
+static void runQueueWorkloads(const std::string& dist, size_t n)
+{
+	KeySet keys = makeKeys(dist, n);
+	Workload work("avl_queue", dist.c_str(), n);
+	long long checksum = 0;
+
+	AVLTree<int, int> tree;
+	for(size_t i = 0; i < n; ++i)
+	{
+		insertKey(tree, keys.order[i]);
+	}
+	AVLTree<int, int> copy(tree);
+
+	work.run("remove_min", n, [&](size_t) {
+		int key = tree.min()->first;
+		checksum += key;
+		tree.remove(key);
+	});
+
+	std::pair<int, int> item;
+	work.run("pop_min", n, [&](size_t) {
+		copy.pop_min(item);
+		checksum += item.first;
+	});
+
+	if(checksum == -1)
+	{
+		std::fprintf(stderr, "checksum %lld\n", checksum);
+	}
+}
+
+/**
+* Times plain inserts, which find the slot for keys past the largest
+* without a walk, against inserts hinted with the previous insert's
+* position, which also catch keys landing just before it.
+*/
+static void runHintWorkloads(const std::string& dist, size_t n)
+{
+	KeySet keys = makeKeys(dist, n);
+	Workload work("avl_hint", dist.c_str(), n);
+
+	AVLTree<int, int> plain;
+	work.run("insert", n, [&](size_t i) { insertKey(plain, keys.order[i]); });
+	plain.clear();
+
+	AVLTree<int, int> hinted;
+	AVLTree<int, int>::iterator hint = hinted.end();
+	work.run("insert_hint", n, [&](size_t i) {
+		hint = hinted.insert(hint, std::make_pair(keys.order[i], keys.order[i]));
+	});
+}
+
+/**
+* Times adding and removing n absent keys in batches of kBatch, each batch
+* in one call to insert_batch() or erase_batch() against a loop of single
+* inserts or removes, on trees that start out as the same n keys.
+*/
+static void runBatchWorkloads(const std::string& dist, size_t n)
+{
+	const size_t kBatch = 10000;
+	KeySet keys = makeKeys(dist, n);
+	Workload work("avl_batch", dist.c_str(), n);
+
+	AVLTree<int, int> loop;
+	for(size_t i = 0; i < n; ++i)
+	{
+		insertKey(loop, keys.order[i]);
+	}
+	AVLTree<int, int> batched(loop);
+
+	std::vector<std::pair<int, int> > items(keys.misses.size());
+	for(size_t i = 0; i < items.size(); ++i)
+	{
+		items[i] = std::make_pair(keys.misses[i], keys.misses[i]);
+	}
+	size_t batches = (n + kBatch - 1) / kBatch;
+
+	work.run("insert_loop", batches, [&](size_t b) {
+		for(size_t i = b * kBatch; i < std::min(n, (b + 1) * kBatch); ++i)
+		{
+			loop.insert(items[i]);
+		}
+	});
+	work.run("insert_batch", batches, [&](size_t b) {
+		batched.insert_batch(items.begin() + b * kBatch, items.begin() + std::min(n, (b + 1) * kBatch));
+	});
+
+	work.run("erase_loop", batches, [&](size_t b) {
+		for(size_t i = b * kBatch; i < std::min(n, (b + 1) * kBatch); ++i)
+		{
+			loop.remove(keys.misses[i]);
+		}
+	});
+	work.run("erase_batch", batches, [&](size_t b) {
+		batched.erase_batch(keys.misses.begin() + b * kBatch, keys.misses.begin() + std::min(n, (b + 1) * kBatch));
+	});
+}
+
+/**
+* A plain AVLTree behind one mutex, the usual way to share a tree between
+* threads and the baseline for ConcurrentAVLTree.
+*/
+class LockedAVLTree
+{
+public:
+	bool find(int key, int& value) const
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		AVLTree<int, int>::const_iterator it = mTree.find(key);
+		if(it == mTree.end())
+		{
+			return false;
+		}
+		value = it->second;
+		return true;
+	}
+
+	void insert(const std::pair<int, int>& item)
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mTree.insert(item);
+	}
+
+	void remove(int key)
+	{
+		std::lock_guard<std::mutex> lock(mLock);
+		mTree.remove(key);
+	}
+
+private:
+	mutable std::mutex mLock;
+	AVLTree<int, int> mTree;
+};
+
+/**
+* Fills a shared tree and then, for each thread count, has that many
+* threads split a fixed number of operations between them: 95% finds of
+* present keys and 5% inserts or erases of absent ones.
+*/
+template<typename Tree>
+static void runConcurrentWorkloads(Tree& tree, const char* name, const std::string& dist, size_t n,
+	const std::vector<size_t>& threadCounts)
+{
+	KeySet keys = makeKeys(dist, n);
+	Workload work(name, dist.c_str(), n);
+	for(size_t i = 0; i < n; ++i)
+	{
+		tree.insert(std::make_pair(keys.order[i], keys.order[i]));
+	}
+
+	size_t totalOps = std::max<size_t>(n, 1000000);
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	for(size_t c = 0; c < threadCounts.size(); ++c)
+	{
+		size_t threads = threadCounts[c];
+		size_t opsPerThread = totalOps / threads;
+		if(threads > cores)
+		{
+			std::fprintf(stderr, "%s: %zu threads on %u cores, so mixed95_t%zu shows time slicing, not scaling\n",
+				name, threads, cores, threads);
+		}
+		std::vector<std::vector<double> > samples(threads);
+		std::atomic<bool> go(false);
+		std::atomic<long long> checksum(0);
+
+		std::vector<std::thread> pool;
+		for(size_t t = 0; t < threads; ++t)
+		{
+			pool.push_back(std::thread([&, t]() {
+				std::mt19937 rng(static_cast<unsigned>(t + 1));
+				samples[t].reserve(opsPerThread / 16 + 1);
+				long long local = 0;
+				while(!go.load(std::memory_order_acquire))
+				{
+					std::this_thread::yield();
+				}
+				for(size_t i = 0; i < opsPerThread; ++i)
+				{
+					size_t at = rng() % n;
+					unsigned choice = rng() % 100;
+					Clock::time_point before;
+					if(i % 16 == 0)
+					{
+						before = Clock::now();
+					}
+
+					int value = 0;
+					if(choice < 95)
+					{
+						local += tree.find(keys.probes[at], value) ? value : 0;
+					}
+					else if(choice < 98)
+					{
+						tree.insert(std::make_pair(keys.misses[at], keys.misses[at]));
+					}
+					else
+					{
+						tree.remove(keys.misses[at]);
+					}
+
+					if(i % 16 == 0)
+					{
+						samples[t].push_back(std::chrono::duration<double, std::nano>(Clock::now() - before).count());
+					}
+				}
+				checksum += local;
+			}));
+		}
+
+		Clock::time_point start = Clock::now();
+		go.store(true, std::memory_order_release);
+		for(size_t t = 0; t < threads; ++t)
+		{
+			pool[t].join();
+		}
+		double secs = std::chrono::duration<double>(Clock::now() - start).count();
+
+		std::vector<double> merged;
+		for(size_t t = 0; t < threads; ++t)
+		{
+			merged.insert(merged.end(), samples[t].begin(), samples[t].end());
+		}
+		std::string label = "mixed95_t" + std::to_string(threads);
+		work.report(label.c_str(), opsPerThread * threads, secs, merged);
+
+		if(checksum == -1)
+		{
+			std::fprintf(stderr, "checksum %lld\n", checksum.load());
+		}
+	}
+}
+
+static void runCase(const std::string& tree, const std::string& dist, size_t n,
+	const std::vector<size_t>& threadCounts)
+{
+	if(tree == "bst")
+	{
+		BinarySearchTree<int, int> t;
+		runWorkloads(t, "bst", dist, n);
+	}
+	else if(tree == "rotate")
+	{
+		rotateBST<int, int> t;
+		runWorkloads(t, "rotate", dist, n);
+	}
+	else if(tree == "avl")
+	{
+		AVLTree<int, int> t;
+		runWorkloads(t, "avl", dist, n);
+	}
+	else if(tree == "avl_heap")
+	{
+		AVLTree<int, int> t(std::make_shared<HeapNodeAllocator>());
+		runWorkloads(t, "avl_heap", dist, n);
+	}
+	else if(tree == "avl_ordered")
+	{
+		OrderedAVLTree<int, int> t;
+		runWorkloads(t, "avl_ordered", dist, n);
+	}
+	else if(tree == "avl_persistent")
+	{
+		PersistentAVLTree<int, int> t;
+		runWorkloads(t, "avl_persistent", dist, n);
+	}
+	else if(tree == "avl_compact")
+	{
+		CompactAVLTree<int, int> t;
+		runWorkloads(t, "avl_compact", dist, n);
+	}
+	else if(tree == "bplus")
+	{
+		BPlusTree<int, int> t;
+		runWorkloads(t, "bplus", dist, n);
+	}
+	else if(tree == "avl64")
+	{
+		AVLTree<std::int64_t, std::int64_t> t;
+		runWorkloads(t, "avl64", dist, n);
+	}
+	else if(tree == "avl64_compact")
+	{
+		CompactAVLTree<std::int64_t, std::int64_t> t;
+		runWorkloads(t, "avl64_compact", dist, n);
+	}
+	else if(tree == "bplus64" || tree == "bplus64_scalar")
+	{
+		// The scalar variant turns off the vector node search to show its effect.
+		if(tree == "bplus64_scalar")
+		{
+			simdLevel() = kSimdNone;
+		}
+		BPlusTree<std::int64_t, std::int64_t> t;
+		runWorkloads(t, tree.c_str(), dist, n);
+	}
+	else if(tree == "avl_frozen")
+	{
+		runFrozenWorkloads(dist, n);
+	}
+	else if(tree == "avl_setops")
+	{
+		runSetWorkloads(dist, n);
+	}
+	else if(tree == "avl_queue")
+	{
+		runQueueWorkloads(dist, n);
+	}
+	else if(tree == "avl_hint")
+	{
+		runHintWorkloads(dist, n);
+	}
+	else if(tree == "avl_batch")
+	{
+		runBatchWorkloads(dist, n);
+	}
+	else if(tree == "avl_concurrent")
+	{
+		ConcurrentAVLTree<int, int> t;
+		runConcurrentWorkloads(t, "avl_concurrent", dist, n, threadCounts);
+	}
+	else if(tree == "avl_mutex")
+	{
+		LockedAVLTree t;
+		runConcurrentWorkloads(t, "avl_mutex", dist, n, threadCounts);
+	}
+	else if(tree == "map")
+	{
+		std::map<int, int> t;
+		runWorkloads(t, "map", dist, n);
+	}
+	else
+	{
+		std::fprintf(stderr, "unknown tree '%s'\n", tree.c_str());
+	}
+}
+
+static std::vector<std::string> splitList(const std::string& list)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while(start <= list.size())
+	{
+		size_t comma = list.find(',', start);
+		if(comma == std::string::npos)
+		{
+			comma = list.size();
+		}
+		if(comma > start)
+		{
+			items.push_back(list.substr(start, comma - start));
+		}
+		start = comma + 1;
+	}
+	return items;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> sizes = splitList("1000,10000,100000,1000000");
+	std::vector<std::string> trees = splitList("bst,rotate,avl,avl_heap,avl_ordered,avl_frozen,avl_persistent,avl_compact,bplus,avl64,avl64_compact,bplus64,bplus64_scalar,map");
+	std::vector<std::string> dists = splitList("sorted,reverse,random,zipf");
+	std::vector<std::string> threadList = splitList("1,2,4,8,16,32");
+	size_t unbalancedLimit = 100000;
+
+	for(int i = 1; i < argc; i += 2)
+	{
+		std::string flag = argv[i];
+		if(i + 1 >= argc)
+		{
+			std::fprintf(stderr, "missing value for '%s'\n", flag.c_str());
+			return 1;
+		}
+		else if(flag == "--sizes")
+		{
+			sizes = splitList(argv[i + 1]);
+		}
+		else if(flag == "--trees")
+		{
+			trees = splitList(argv[i + 1]);
+		}
+		else if(flag == "--dists")
+		{
+			dists = splitList(argv[i + 1]);
+		}
+		else if(flag == "--threads")
+		{
+			threadList = splitList(argv[i + 1]);
+		}
+		else if(flag == "--unbalanced-limit")
+		{
+			unbalancedLimit = std::strtoul(argv[i + 1], nullptr, 10);
+		}
+		else
+		{
+			std::fprintf(stderr, "unknown flag '%s'\n", flag.c_str());
+			return 1;
+		}
+	}
+
+	std::vector<size_t> threadCounts;
+	for(size_t i = 0; i < threadList.size(); ++i)
+	{
+		threadCounts.push_back(std::max<size_t>(1, std::strtoul(threadList[i].c_str(), nullptr, 10)));
+	}
+
+	std::printf("tree,distribution,n,workload,ops,ops_per_sec,p50_ns,p99_ns,peak_rss_kb\n");
+	std::fflush(stdout);
+
+	for(size_t s = 0; s < sizes.size(); ++s)
+	{
+		size_t n = std::strtoul(sizes[s].c_str(), nullptr, 10);
+		for(size_t d = 0; d < dists.size(); ++d)
+		{
+			for(size_t t = 0; t < trees.size(); ++t)
+			{
+				bool unbalanced = trees[t] == "bst" || trees[t] == "rotate";
+				bool presorted = dists[d] == "sorted" || dists[d] == "reverse" || dists[d] == "nearly_sorted";
+				if(unbalanced && presorted && n > unbalancedLimit)
+				{
+					std::fprintf(stderr, "skipping %s/%s/%zu: quadratic on presorted keys\n",
+						trees[t].c_str(), dists[d].c_str(), n);
+					continue;
+				}
+
+				pid_t child = fork();
+				if(child < 0)
+				{
+					std::perror("fork");
+					return 1;
+				}
+				if(child == 0)
+				{
+					runCase(trees[t], dists[d], n, threadCounts);
+					std::exit(0);
+				}
+
+				int status = 0;
+				waitpid(child, &status, 0);
+				if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+				{
+					std::fprintf(stderr, "%s/%s/%zu failed\n", trees[t].c_str(), dists[d].c_str(), n);
+				}
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,1335 @@
+#ifndef BPLUSTREE_H
+#define BPLUSTREE_H
+
+#include <cstddef>
+#include <utility>
+#include <memory>
+#include <type_traits>
+#include <algorithm>
+#include <iterator>
+#include "bst.h"
+#include "nodepool.h"
+#include "simdsearch.h"
+
+/**
+* The number of slots of the given size that fit in a node of the given
+* size after its header, but never fewer than four so that splitting
+* and merging always leave each node with at least two entries.
+*/
+constexpr std::size_t bplusSlots(std::size_t nodeBytes, std::size_t header, std::size_t slot)
+{
+	return nodeBytes < header + 4 * slot ? 4 : (nodeBytes - header) / slot;
+}
+
+/**
+* A B+ tree mapping unique keys to values, offering the same insert,
+* remove, find and iterator interface as BinarySearchTree so it can be
+* swapped in for it.
+*
+* Each node fills NodeBytes (a few cache lines), so one node visit
+* compares against dozens of keys instead of one, and a lookup touches
+* about log_32(n) nodes rather than log_2(n). Items live only in the
+* leaves, which are linked in both directions so that iteration and
+* range scans walk contiguous arrays and never climb back up the tree.
+*
+* Keys and values are stored in separate arrays inside each leaf, so
+* iterators hand out a pair of references rather than a reference to a
+* stored std::pair; it->first and it->second work as usual. Key and
+* Value must be default constructible and move assignable.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes = 256>
+class BPlusTree
+{
+	protected:
+		struct NodeBase;
+		struct Leaf;
+		struct Inner;
+
+	public:
+		BPlusTree();
+		BPlusTree(const BPlusTree<Key, Value, NodeBytes>& other);
+		BPlusTree(BPlusTree<Key, Value, NodeBytes>&& other);
+		~BPlusTree();
+		BPlusTree<Key, Value, NodeBytes>& operator=(const BPlusTree<Key, Value, NodeBytes>& other);
+		BPlusTree<Key, Value, NodeBytes>& operator=(BPlusTree<Key, Value, NodeBytes>&& other);
+		void insert(const std::pair<Key, Value>& keyValuePair);
+		void insert(std::pair<Key, Value>&& keyValuePair);
+		void remove(const Key& key);
+		void clear();
+		std::size_t size() const;
+		bool empty() const;
+		TreeStats validate() const;
+
+	public:
+		/**
+		* A bidirectional iterator over the items in key order.
+		*/
+		class iterator
+		{
+			public:
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef std::pair<Key, Value> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef std::pair<const Key&, Value&> reference;
+
+				/**
+				* What operator-> returns, so that it->second reaches the value.
+				*/
+				class pointer
+				{
+					public:
+						explicit pointer(const reference& item) : mItem(item) {}
+						const reference* operator->() const { return &mItem; }
+
+					private:
+						reference mItem;
+				};
+
+				iterator(Leaf* leaf, std::size_t index, const BPlusTree<Key, Value, NodeBytes>* tree);
+				iterator();
+
+				reference operator*() const;
+				pointer operator->() const;
+
+				bool operator==(const iterator& rhs) const;
+				bool operator!=(const iterator& rhs) const;
+
+				iterator& operator++();
+				iterator operator++(int);
+				iterator& operator--();
+				iterator operator--(int);
+
+			protected:
+				Leaf* mLeaf;
+				std::size_t mIndex;
+				const BPlusTree<Key, Value, NodeBytes>* mTree;
+
+				friend class BPlusTree<Key, Value, NodeBytes>;
+		};
+
+		/**
+		* An iterator that gives read-only access to the items.
+		*/
+		class const_iterator
+		{
+			public:
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef std::pair<Key, Value> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef std::pair<const Key&, const Value&> reference;
+
+				/**
+				* What operator-> returns, so that it->second reaches the value.
+				*/
+				class pointer
+				{
+					public:
+						explicit pointer(const reference& item) : mItem(item) {}
+						const reference* operator->() const { return &mItem; }
+
+					private:
+						reference mItem;
+				};
+
+				const_iterator(const Leaf* leaf, std::size_t index, const BPlusTree<Key, Value, NodeBytes>* tree);
+				const_iterator(const iterator& it);
+				const_iterator();
+
+				reference operator*() const;
+				pointer operator->() const;
+
+				bool operator==(const const_iterator& rhs) const;
+				bool operator!=(const const_iterator& rhs) const;
+
+				const_iterator& operator++();
+				const_iterator operator++(int);
+				const_iterator& operator--();
+				const_iterator operator--(int);
+
+			protected:
+				const Leaf* mLeaf;
+				std::size_t mIndex;
+				const BPlusTree<Key, Value, NodeBytes>* mTree;
+		};
+
+	public:
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+		const_iterator cbegin() const;
+		const_iterator cend() const;
+		iterator find(const Key& key) const;
+		iterator lower_bound(const Key& key) const;
+		iterator upper_bound(const Key& key) const;
+		std::pair<iterator, iterator> equal_range(const Key& key) const;
+
+	protected:
+		static const std::size_t kLeafSlots = bplusSlots(NodeBytes, 3 * sizeof(void*), sizeof(Key) + sizeof(Value));
+		static const std::size_t kInnerSlots = bplusSlots(NodeBytes, 2 * sizeof(void*), sizeof(Key) + sizeof(void*));
+		static const std::size_t kMinLeaf = kLeafSlots / 2;
+		static const std::size_t kMinInner = kInnerSlots / 2;
+		static const std::size_t kMaxDepth = 64;
+
+		struct NodeBase
+		{
+			explicit NodeBase(bool leaf) : mCount(0), mLeaf(leaf) {}
+
+			unsigned mCount;	// items in a leaf, separator keys in an inner node
+			bool mLeaf;
+		};
+
+		/**
+		* A leaf holds up to kLeafSlots items with keys in increasing order.
+		*/
+		struct Leaf : NodeBase
+		{
+			Leaf() : NodeBase(true), mPrev(nullptr), mNext(nullptr) {}
+
+			Leaf* mPrev;
+			Leaf* mNext;
+			Key mKeys[kLeafSlots];
+			Value mValues[kLeafSlots];
+		};
+
+		/**
+		* An inner node with mCount separators has mCount + 1 children, and
+		* child i holds the keys k with mKeys[i - 1] <= k < mKeys[i].
+		*/
+		struct Inner : NodeBase
+		{
+			Inner() : NodeBase(false) {}
+
+			Key mKeys[kInnerSlots];
+			NodeBase* mChildren[kInnerSlots + 1];
+		};
+
+		/**
+		* One step of a descent: the inner node passed and the child taken.
+		*/
+		struct PathStep
+		{
+			Inner* node;
+			std::size_t index;
+		};
+
+		static std::size_t lowerIndex(const Key* keys, std::size_t count, const Key& key);
+		static std::size_t upperIndex(const Key* keys, std::size_t count, const Key& key);
+		Leaf* findLeaf(const Key& key) const;
+		Leaf* descend(const Key& key, PathStep* path, std::size_t& depth) const;
+		template<typename K, typename V>
+		void insertItem(K&& key, V&& value);
+		template<typename K, typename V>
+		static void insertIntoLeaf(Leaf* leaf, std::size_t pos, K&& key, V&& value);
+		void insertSeparator(PathStep* path, std::size_t depth, Key separator, NodeBase* child);
+		bool rebalanceLeaf(Leaf* leaf, Inner* parent, std::size_t index);
+		bool rebalanceInner(Inner* node, Inner* parent, std::size_t index);
+		void mergeLeaves(Leaf* left, Leaf* right);
+		void mergeInner(Inner* left, Inner* right, Inner* parent, std::size_t keyIndex);
+		static void removeEntry(Inner* node, std::size_t keyIndex);
+		Leaf* createLeaf();
+		Inner* createInner();
+		void destroyNode(Leaf* leaf);
+		void destroyNode(Inner* inner);
+		void helpClear(NodeBase* node);
+		void validateNode(const NodeBase* node, int depth, const Key* low, const Key* high,
+			TreeStats& stats, int& leafDepth, const Leaf*& prevLeaf) const;
+
+	protected:
+		NodeBase* mRoot;
+		Leaf* mFirst;
+		Leaf* mLast;
+		std::size_t mSize;
+		std::shared_ptr<NodeAllocator> mLeafAllocator;
+		std::shared_ptr<NodeAllocator> mInnerAllocator;
+};
+
+template <typename Key, typename Value, std::size_t NodeBytes>
+const std::size_t BPlusTree<Key, Value, NodeBytes>::kLeafSlots;
+template <typename Key, typename Value, std::size_t NodeBytes>
+const std::size_t BPlusTree<Key, Value, NodeBytes>::kInnerSlots;
+template <typename Key, typename Value, std::size_t NodeBytes>
+const std::size_t BPlusTree<Key, Value, NodeBytes>::kMinLeaf;
+template <typename Key, typename Value, std::size_t NodeBytes>
+const std::size_t BPlusTree<Key, Value, NodeBytes>::kMinInner;
+template <typename Key, typename Value, std::size_t NodeBytes>
+const std::size_t BPlusTree<Key, Value, NodeBytes>::kMaxDepth;
+
+/*
+	--------------------------------------------------------
+	Begin implementations for the BPlusTree::iterator class.
+	--------------------------------------------------------
+*/
+
+/**
+* Constructor for an iterator at the given slot of a leaf. A null leaf
+* is the end iterator, which needs the tree to step back from.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::iterator::iterator(Leaf* leaf, std::size_t index, const BPlusTree<Key, Value, NodeBytes>* tree)
+	: mLeaf(leaf)
+	, mIndex(index)
+	, mTree(tree)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::iterator::iterator()
+	: mLeaf(nullptr)
+	, mIndex(0)
+	, mTree(nullptr)
+{
+
+}
+
+/**
+* Provides access to the key and value of the item.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator::reference BPlusTree<Key, Value, NodeBytes>::iterator::operator*() const
+{
+	return reference(mLeaf->mKeys[mIndex], mLeaf->mValues[mIndex]);
+}
+
+/**
+* Provides member access to the key and value of the item.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator::pointer BPlusTree<Key, Value, NodeBytes>::iterator::operator->() const
+{
+	return pointer(**this);
+}
+
+/**
+* Checks if 'this' iterator is at the same item as 'rhs'
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::iterator::operator==(const iterator& rhs) const
+{
+	return mLeaf == rhs.mLeaf && mIndex == rhs.mIndex;
+}
+
+/**
+* Checks if 'this' iterator is at a different item than 'rhs'
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::iterator::operator!=(const iterator& rhs) const
+{
+	return !(*this == rhs);
+}
+
+/**
+* Advances to the next item, moving on to the next leaf at the end of this one.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator& BPlusTree<Key, Value, NodeBytes>::iterator::operator++()
+{
+	if(++mIndex == mLeaf->mCount)
+	{
+		mLeaf = mLeaf->mNext;
+		mIndex = 0;
+	}
+	return *this;
+}
+
+/**
+* Advances the iterator, returning a copy of its old position.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::iterator::operator++(int)
+{
+	iterator old(*this);
+	++(*this);
+	return old;
+}
+
+/**
+* Moves back to the previous item. The end iterator moves back to the largest item.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator& BPlusTree<Key, Value, NodeBytes>::iterator::operator--()
+{
+	if(mLeaf == nullptr || mIndex == 0)
+	{
+		mLeaf = mLeaf ? mLeaf->mPrev : mTree->mLast;
+		mIndex = mLeaf->mCount;
+	}
+	--mIndex;
+	return *this;
+}
+
+/**
+* Moves the iterator back, returning a copy of its old position.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::iterator::operator--(int)
+{
+	iterator old(*this);
+	--(*this);
+	return old;
+}
+
+/**
+* Constructor for a const_iterator at the given slot of a leaf.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::const_iterator::const_iterator(const Leaf* leaf, std::size_t index, const BPlusTree<Key, Value, NodeBytes>* tree)
+	: mLeaf(leaf)
+	, mIndex(index)
+	, mTree(tree)
+{
+
+}
+
+/**
+* Converts a mutable iterator into a read-only one.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::const_iterator::const_iterator(const iterator& it)
+	: mLeaf(it.mLeaf)
+	, mIndex(it.mIndex)
+	, mTree(it.mTree)
+{
+
+}
+
+/**
+* A default constructor that initializes the const_iterator to NULL.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::const_iterator::const_iterator()
+	: mLeaf(nullptr)
+	, mIndex(0)
+	, mTree(nullptr)
+{
+
+}
+
+/**
+* Provides read-only access to the key and value of the item.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator::reference BPlusTree<Key, Value, NodeBytes>::const_iterator::operator*() const
+{
+	return reference(mLeaf->mKeys[mIndex], mLeaf->mValues[mIndex]);
+}
+
+/**
+* Provides read-only member access to the key and value of the item.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator::pointer BPlusTree<Key, Value, NodeBytes>::const_iterator::operator->() const
+{
+	return pointer(**this);
+}
+
+/**
+* Checks if 'this' const_iterator is at the same item as 'rhs'
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::const_iterator::operator==(const const_iterator& rhs) const
+{
+	return mLeaf == rhs.mLeaf && mIndex == rhs.mIndex;
+}
+
+/**
+* Checks if 'this' const_iterator is at a different item than 'rhs'
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+	return !(*this == rhs);
+}
+
+/**
+* Advances to the next item, moving on to the next leaf at the end of this one.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator& BPlusTree<Key, Value, NodeBytes>::const_iterator::operator++()
+{
+	if(++mIndex == mLeaf->mCount)
+	{
+		mLeaf = mLeaf->mNext;
+		mIndex = 0;
+	}
+	return *this;
+}
+
+/**
+* Advances the const_iterator, returning a copy of its old position.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator BPlusTree<Key, Value, NodeBytes>::const_iterator::operator++(int)
+{
+	const_iterator old(*this);
+	++(*this);
+	return old;
+}
+
+/**
+* Moves back to the previous item. The end iterator moves back to the largest item.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator& BPlusTree<Key, Value, NodeBytes>::const_iterator::operator--()
+{
+	if(mLeaf == nullptr || mIndex == 0)
+	{
+		mLeaf = mLeaf ? mLeaf->mPrev : mTree->mLast;
+		mIndex = mLeaf->mCount;
+	}
+	--mIndex;
+	return *this;
+}
+
+/**
+* Moves the const_iterator back, returning a copy of its old position.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator BPlusTree<Key, Value, NodeBytes>::const_iterator::operator--(int)
+{
+	const_iterator old(*this);
+	--(*this);
+	return old;
+}
+
+/*
+	------------------------------------------------------
+	End implementations for the BPlusTree::iterator class.
+	------------------------------------------------------
+*/
+
+/*
+	----------------------------------------------
+	Begin implementations for the BPlusTree class.
+	----------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree. Leaves and inner nodes have
+* different sizes, so each kind is drawn from its own pool.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::BPlusTree()
+	: mRoot(nullptr)
+	, mFirst(nullptr)
+	, mLast(nullptr)
+	, mSize(0)
+	, mLeafAllocator(std::make_shared<NodePool>())
+	, mInnerAllocator(std::make_shared<NodePool>())
+{
+
+}
+
+/**
+* Copy constructor. Items arrive in key order, so each insert lands in
+* the rightmost leaf.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::BPlusTree(const BPlusTree<Key, Value, NodeBytes>& other)
+	: BPlusTree()
+{
+	for(const Leaf* leaf = other.mFirst; leaf; leaf = leaf->mNext)
+	{
+		for(std::size_t i = 0; i < leaf->mCount; ++i)
+		{
+			insertItem(leaf->mKeys[i], leaf->mValues[i]);
+		}
+	}
+}
+
+/**
+* Move constructor. Takes over the nodes and their pools, leaving the
+* other tree empty with fresh pools of its own.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::BPlusTree(BPlusTree<Key, Value, NodeBytes>&& other)
+	: BPlusTree()
+{
+	*this = std::move(other);
+}
+
+/**
+* Destructor for the tree, which frees every node.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>::~BPlusTree()
+{
+	clear();
+}
+
+/**
+* Copy assignment, replacing this tree's items with copies of the other's.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>& BPlusTree<Key, Value, NodeBytes>::operator=(const BPlusTree<Key, Value, NodeBytes>& other)
+{
+	if(this != &other)
+	{
+		BPlusTree<Key, Value, NodeBytes> copy(other);
+		*this = std::move(copy);
+	}
+	return *this;
+}
+
+/**
+* Move assignment, swapping nodes and pools so the other tree frees ours.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+BPlusTree<Key, Value, NodeBytes>& BPlusTree<Key, Value, NodeBytes>::operator=(BPlusTree<Key, Value, NodeBytes>&& other)
+{
+	std::swap(mRoot, other.mRoot);
+	std::swap(mFirst, other.mFirst);
+	std::swap(mLast, other.mLast);
+	std::swap(mSize, other.mSize);
+	std::swap(mLeafAllocator, other.mLeafAllocator);
+	std::swap(mInnerAllocator, other.mInnerAllocator);
+	other.clear();
+	return *this;
+}
+
+/**
+* Inserts a copy of the item, overwriting the value if the key is present.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+	insertItem(keyValuePair.first, keyValuePair.second);
+}
+
+/**
+* Moves the item into the tree, or just its value if the key is present.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+	insertItem(std::move(keyValuePair.first), std::move(keyValuePair.second));
+}
+
+/**
+* Removes the item with the given key, if any. A leaf left less than half
+* full borrows an item from a sibling or merges with it, and a merge may
+* in turn leave the parent short, all the way up to the root.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::remove(const Key& key)
+{
+	if(mRoot == nullptr)
+	{
+		return;
+	}
+
+	PathStep path[kMaxDepth];
+	std::size_t depth = 0;
+	Leaf* leaf = descend(key, path, depth);
+	std::size_t pos = lowerIndex(leaf->mKeys, leaf->mCount, key);
+	if(pos == leaf->mCount || key < leaf->mKeys[pos])
+	{
+		return;
+	}
+
+	std::move(leaf->mKeys + pos + 1, leaf->mKeys + leaf->mCount, leaf->mKeys + pos);
+	std::move(leaf->mValues + pos + 1, leaf->mValues + leaf->mCount, leaf->mValues + pos);
+	--leaf->mCount;
+	--mSize;
+
+	if(depth == 0)
+	{
+		if(leaf->mCount == 0)
+		{
+			destroyNode(leaf);
+			mRoot = mFirst = mLast = nullptr;
+		}
+		return;
+	}
+
+	if(leaf->mCount >= kMinLeaf || !rebalanceLeaf(leaf, path[depth - 1].node, path[depth - 1].index))
+	{
+		return;
+	}
+
+	for(std::size_t d = depth - 1; ; --d)
+	{
+		Inner* node = path[d].node;
+		if(d == 0)
+		{
+			if(node->mCount == 0)
+			{
+				mRoot = node->mChildren[0];
+				destroyNode(node);
+			}
+			return;
+		}
+		if(node->mCount >= kMinInner || !rebalanceInner(node, path[d - 1].node, path[d - 1].index))
+		{
+			return;
+		}
+	}
+}
+
+/**
+* Deletes every item. When the pools belong to this tree alone and no
+* destructors need to run, the pools are dropped wholesale instead.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::clear()
+{
+	if(mRoot == nullptr)
+	{
+		return;
+	}
+	if(!std::is_trivially_destructible<Key>::value || !std::is_trivially_destructible<Value>::value
+		|| mLeafAllocator.use_count() != 1 || mInnerAllocator.use_count() != 1
+		|| !mLeafAllocator->release() || !mInnerAllocator->release())
+	{
+		helpClear(mRoot);
+	}
+	mRoot = nullptr;
+	mFirst = nullptr;
+	mLast = nullptr;
+	mSize = 0;
+}
+
+/**
+* Returns the number of items in the tree.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+std::size_t BPlusTree<Key, Value, NodeBytes>::size() const
+{
+	return mSize;
+}
+
+/**
+* Returns true if the tree holds no items.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::empty() const
+{
+	return mSize == 0;
+}
+
+/**
+* Checks the tree's invariants in one pass. 'balanced' means every leaf
+* is at the same depth and no node other than the root is under half
+* full; 'linked' covers the chain of leaves.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+TreeStats BPlusTree<Key, Value, NodeBytes>::validate() const
+{
+	TreeStats stats = {true, true, true, true, true, true, 0, 0};
+	if(mRoot == nullptr)
+	{
+		stats.linked = mFirst == nullptr && mLast == nullptr;
+		stats.countsValid = mSize == 0;
+		return stats;
+	}
+
+	int leafDepth = -1;
+	const Leaf* prevLeaf = nullptr;
+	validateNode(mRoot, 0, nullptr, nullptr, stats, leafDepth, prevLeaf);
+	stats.height = leafDepth + 1;
+	stats.linked = stats.linked && prevLeaf == mLast && mLast->mNext == nullptr;
+	stats.countsValid = stats.size == mSize;
+	return stats;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::begin()
+{
+	return iterator(mFirst, 0, this);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::end()
+{
+	return iterator(nullptr, 0, this);
+}
+
+/**
+* Returns a read-only iterator to the smallest item.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator BPlusTree<Key, Value, NodeBytes>::begin() const
+{
+	return const_iterator(mFirst, 0, this);
+}
+
+/**
+* Returns the read-only end iterator.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator BPlusTree<Key, Value, NodeBytes>::end() const
+{
+	return const_iterator(nullptr, 0, this);
+}
+
+/**
+* Same as begin() const, even on a mutable tree.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator BPlusTree<Key, Value, NodeBytes>::cbegin() const
+{
+	return begin();
+}
+
+/**
+* Same as end() const, even on a mutable tree.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::const_iterator BPlusTree<Key, Value, NodeBytes>::cend() const
+{
+	return end();
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::find(const Key& key) const
+{
+	if(mRoot == nullptr)
+	{
+		return iterator(nullptr, 0, this);
+	}
+	Leaf* leaf = findLeaf(key);
+	std::size_t pos = lowerIndex(leaf->mKeys, leaf->mCount, key);
+	if(pos == leaf->mCount || key < leaf->mKeys[pos])
+	{
+		return iterator(nullptr, 0, this);
+	}
+	return iterator(leaf, pos, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than the
+* given key, or the end iterator if there is none.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::lower_bound(const Key& key) const
+{
+	if(mRoot == nullptr)
+	{
+		return iterator(nullptr, 0, this);
+	}
+	Leaf* leaf = findLeaf(key);
+	std::size_t pos = lowerIndex(leaf->mKeys, leaf->mCount, key);
+	if(pos == leaf->mCount)
+	{
+		return iterator(leaf->mNext, 0, this);
+	}
+	return iterator(leaf, pos, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than the
+* given key, or the end iterator if there is none.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::iterator BPlusTree<Key, Value, NodeBytes>::upper_bound(const Key& key) const
+{
+	if(mRoot == nullptr)
+	{
+		return iterator(nullptr, 0, this);
+	}
+	Leaf* leaf = findLeaf(key);
+	std::size_t pos = upperIndex(leaf->mKeys, leaf->mCount, key);
+	if(pos == leaf->mCount)
+	{
+		return iterator(leaf->mNext, 0, this);
+	}
+	return iterator(leaf, pos, this);
+}
+
+/**
+* Returns the range of items matching the given key, which holds
+* at most one item since keys are unique.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+std::pair<typename BPlusTree<Key, Value, NodeBytes>::iterator, typename BPlusTree<Key, Value, NodeBytes>::iterator>
+BPlusTree<Key, Value, NodeBytes>::equal_range(const Key& key) const
+{
+	iterator first = lower_bound(key);
+	iterator last = first;
+	if(first.mLeaf && !(key < first->first))
+	{
+		++last;
+	}
+	return std::make_pair(first, last);
+}
+
+/**
+* Returns the index of the first of the sorted keys that is not less
+* than the given key. Integer and floating point keys are searched with
+* vector compares where the CPU supports them.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+std::size_t BPlusTree<Key, Value, NodeBytes>::lowerIndex(const Key* keys, std::size_t count, const Key& key)
+{
+	return nodeLowerIndex(keys, count, key);
+}
+
+/**
+* Returns the index of the first of the sorted keys that is greater
+* than the given key.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+std::size_t BPlusTree<Key, Value, NodeBytes>::upperIndex(const Key* keys, std::size_t count, const Key& key)
+{
+	return nodeUpperIndex(keys, count, key);
+}
+
+/**
+* Returns the leaf whose range covers the key. The tree must not be empty.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::Leaf* BPlusTree<Key, Value, NodeBytes>::findLeaf(const Key& key) const
+{
+	NodeBase* node = mRoot;
+	while(!node->mLeaf)
+	{
+		Inner* inner = static_cast<Inner*>(node);
+		node = inner->mChildren[upperIndex(inner->mKeys, inner->mCount, key)];
+	}
+	return static_cast<Leaf*>(node);
+}
+
+/**
+* Same as findLeaf, but records each inner node passed and the child
+* taken from it, since nodes keep no parent pointers.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::Leaf* BPlusTree<Key, Value, NodeBytes>::descend(const Key& key, PathStep* path, std::size_t& depth) const
+{
+	NodeBase* node = mRoot;
+	while(!node->mLeaf)
+	{
+		Inner* inner = static_cast<Inner*>(node);
+		std::size_t index = upperIndex(inner->mKeys, inner->mCount, key);
+		path[depth].node = inner;
+		path[depth].index = index;
+		++depth;
+		node = inner->mChildren[index];
+	}
+	return static_cast<Leaf*>(node);
+}
+
+/**
+* Inserts or overwrites an item. A full leaf is split in half and the
+* first key of the new right half is added to the parent, which may
+* split in turn; a split root grows the tree by one level.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+template<typename K, typename V>
+void BPlusTree<Key, Value, NodeBytes>::insertItem(K&& key, V&& value)
+{
+	if(mRoot == nullptr)
+	{
+		Leaf* leaf = createLeaf();
+		insertIntoLeaf(leaf, 0, std::forward<K>(key), std::forward<V>(value));
+		mRoot = mFirst = mLast = leaf;
+		mSize = 1;
+		return;
+	}
+
+	PathStep path[kMaxDepth];
+	std::size_t depth = 0;
+	Leaf* leaf = descend(key, path, depth);
+	std::size_t pos = lowerIndex(leaf->mKeys, leaf->mCount, key);
+	if(pos < leaf->mCount && !(key < leaf->mKeys[pos]))
+	{
+		leaf->mValues[pos] = std::forward<V>(value);
+		return;
+	}
+
+	if(leaf->mCount < kLeafSlots)
+	{
+		insertIntoLeaf(leaf, pos, std::forward<K>(key), std::forward<V>(value));
+		++mSize;
+		return;
+	}
+
+	Leaf* right = createLeaf();
+	std::size_t split = leaf->mCount / 2;
+	std::move(leaf->mKeys + split, leaf->mKeys + leaf->mCount, right->mKeys);
+	std::move(leaf->mValues + split, leaf->mValues + leaf->mCount, right->mValues);
+	right->mCount = leaf->mCount - split;
+	leaf->mCount = split;
+
+	right->mPrev = leaf;
+	right->mNext = leaf->mNext;
+	if(leaf->mNext)
+	{
+		leaf->mNext->mPrev = right;
+
+	} else {
+
+		mLast = right;
+	}
+	leaf->mNext = right;
+
+	if(pos <= split)
+	{
+		insertIntoLeaf(leaf, pos, std::forward<K>(key), std::forward<V>(value));
+
+	} else {
+
+		insertIntoLeaf(right, pos - split, std::forward<K>(key), std::forward<V>(value));
+	}
+	++mSize;
+	insertSeparator(path, depth, right->mKeys[0], right);
+}
+
+/**
+* Shifts the items from pos on up one slot and puts the new item at pos.
+* The leaf must have a free slot.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+template<typename K, typename V>
+void BPlusTree<Key, Value, NodeBytes>::insertIntoLeaf(Leaf* leaf, std::size_t pos, K&& key, V&& value)
+{
+	std::move_backward(leaf->mKeys + pos, leaf->mKeys + leaf->mCount, leaf->mKeys + leaf->mCount + 1);
+	std::move_backward(leaf->mValues + pos, leaf->mValues + leaf->mCount, leaf->mValues + leaf->mCount + 1);
+	leaf->mKeys[pos] = std::forward<K>(key);
+	leaf->mValues[pos] = std::forward<V>(value);
+	++leaf->mCount;
+}
+
+/**
+* Adds a separator and the new child to its right to the inner node at
+* the bottom of the path, splitting full nodes on the way up.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::insertSeparator(PathStep* path, std::size_t depth, Key separator, NodeBase* child)
+{
+	while(depth > 0)
+	{
+		--depth;
+		Inner* node = path[depth].node;
+		std::size_t index = path[depth].index;
+
+		if(node->mCount < kInnerSlots)
+		{
+			std::move_backward(node->mKeys + index, node->mKeys + node->mCount, node->mKeys + node->mCount + 1);
+			std::move_backward(node->mChildren + index + 1, node->mChildren + node->mCount + 1, node->mChildren + node->mCount + 2);
+			node->mKeys[index] = std::move(separator);
+			node->mChildren[index + 1] = child;
+			++node->mCount;
+			return;
+		}
+
+		// Lay out the overfull node in scratch arrays, keep the lower half,
+		// move the upper half to a new node and push the middle key up.
+		Inner* right = createInner();
+		Key keys[kInnerSlots + 1];
+		NodeBase* children[kInnerSlots + 2];
+		std::move(node->mKeys, node->mKeys + index, keys);
+		keys[index] = std::move(separator);
+		std::move(node->mKeys + index, node->mKeys + kInnerSlots, keys + index + 1);
+		std::copy(node->mChildren, node->mChildren + index + 1, children);
+		children[index + 1] = child;
+		std::copy(node->mChildren + index + 1, node->mChildren + kInnerSlots + 1, children + index + 2);
+
+		std::size_t total = kInnerSlots + 1;
+		std::size_t mid = total / 2;
+		std::move(keys, keys + mid, node->mKeys);
+		std::copy(children, children + mid + 1, node->mChildren);
+		node->mCount = mid;
+		std::move(keys + mid + 1, keys + total, right->mKeys);
+		std::copy(children + mid + 1, children + total + 1, right->mChildren);
+		right->mCount = total - mid - 1;
+
+		separator = std::move(keys[mid]);
+		child = right;
+	}
+
+	Inner* root = createInner();
+	root->mKeys[0] = std::move(separator);
+	root->mChildren[0] = mRoot;
+	root->mChildren[1] = child;
+	root->mCount = 1;
+	mRoot = root;
+}
+
+/**
+* Refills a leaf that fell under half full from the sibling with items
+* to spare, or merges it with a sibling. Returns true if the parent lost
+* an entry to a merge.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::rebalanceLeaf(Leaf* leaf, Inner* parent, std::size_t index)
+{
+	Leaf* left = index > 0 ? static_cast<Leaf*>(parent->mChildren[index - 1]) : nullptr;
+	Leaf* right = index < parent->mCount ? static_cast<Leaf*>(parent->mChildren[index + 1]) : nullptr;
+
+	if(left && left->mCount > kMinLeaf)
+	{
+		std::size_t last = left->mCount - 1;
+		insertIntoLeaf(leaf, 0, std::move(left->mKeys[last]), std::move(left->mValues[last]));
+		--left->mCount;
+		parent->mKeys[index - 1] = leaf->mKeys[0];
+		return false;
+	}
+
+	if(right && right->mCount > kMinLeaf)
+	{
+		insertIntoLeaf(leaf, leaf->mCount, std::move(right->mKeys[0]), std::move(right->mValues[0]));
+		std::move(right->mKeys + 1, right->mKeys + right->mCount, right->mKeys);
+		std::move(right->mValues + 1, right->mValues + right->mCount, right->mValues);
+		--right->mCount;
+		parent->mKeys[index] = right->mKeys[0];
+		return false;
+	}
+
+	if(left)
+	{
+		mergeLeaves(left, leaf);
+		removeEntry(parent, index - 1);
+
+	} else {
+
+		mergeLeaves(leaf, right);
+		removeEntry(parent, index);
+	}
+	return true;
+}
+
+/**
+* The inner node counterpart of rebalanceLeaf. Borrowing rotates a key
+* through the parent, and merging pulls the parent's separator down.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+bool BPlusTree<Key, Value, NodeBytes>::rebalanceInner(Inner* node, Inner* parent, std::size_t index)
+{
+	Inner* left = index > 0 ? static_cast<Inner*>(parent->mChildren[index - 1]) : nullptr;
+	Inner* right = index < parent->mCount ? static_cast<Inner*>(parent->mChildren[index + 1]) : nullptr;
+
+	if(left && left->mCount > kMinInner)
+	{
+		std::move_backward(node->mKeys, node->mKeys + node->mCount, node->mKeys + node->mCount + 1);
+		std::move_backward(node->mChildren, node->mChildren + node->mCount + 1, node->mChildren + node->mCount + 2);
+		node->mKeys[0] = std::move(parent->mKeys[index - 1]);
+		node->mChildren[0] = left->mChildren[left->mCount];
+		++node->mCount;
+		parent->mKeys[index - 1] = std::move(left->mKeys[left->mCount - 1]);
+		--left->mCount;
+		return false;
+	}
+
+	if(right && right->mCount > kMinInner)
+	{
+		node->mKeys[node->mCount] = std::move(parent->mKeys[index]);
+		node->mChildren[node->mCount + 1] = right->mChildren[0];
+		++node->mCount;
+		parent->mKeys[index] = std::move(right->mKeys[0]);
+		std::move(right->mKeys + 1, right->mKeys + right->mCount, right->mKeys);
+		std::move(right->mChildren + 1, right->mChildren + right->mCount + 1, right->mChildren);
+		--right->mCount;
+		return false;
+	}
+
+	if(left)
+	{
+		mergeInner(left, node, parent, index - 1);
+
+	} else {
+
+		mergeInner(node, right, parent, index);
+	}
+	return true;
+}
+
+/**
+* Appends the right leaf's items to the left leaf and frees the right one.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::mergeLeaves(Leaf* left, Leaf* right)
+{
+	std::move(right->mKeys, right->mKeys + right->mCount, left->mKeys + left->mCount);
+	std::move(right->mValues, right->mValues + right->mCount, left->mValues + left->mCount);
+	left->mCount += right->mCount;
+
+	left->mNext = right->mNext;
+	if(right->mNext)
+	{
+		right->mNext->mPrev = left;
+
+	} else {
+
+		mLast = left;
+	}
+	destroyNode(right);
+}
+
+/**
+* Joins two adjacent inner nodes around the parent's separator between
+* them and removes that separator from the parent.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::mergeInner(Inner* left, Inner* right, Inner* parent, std::size_t keyIndex)
+{
+	left->mKeys[left->mCount] = std::move(parent->mKeys[keyIndex]);
+	std::move(right->mKeys, right->mKeys + right->mCount, left->mKeys + left->mCount + 1);
+	std::copy(right->mChildren, right->mChildren + right->mCount + 1, left->mChildren + left->mCount + 1);
+	left->mCount += right->mCount + 1;
+	destroyNode(right);
+	removeEntry(parent, keyIndex);
+}
+
+/**
+* Removes a separator and the child to its right from an inner node.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::removeEntry(Inner* node, std::size_t keyIndex)
+{
+	std::move(node->mKeys + keyIndex + 1, node->mKeys + node->mCount, node->mKeys + keyIndex);
+	std::move(node->mChildren + keyIndex + 2, node->mChildren + node->mCount + 1, node->mChildren + keyIndex + 1);
+	--node->mCount;
+}
+
+/**
+* Allocates an empty leaf from the leaf pool.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::Leaf* BPlusTree<Key, Value, NodeBytes>::createLeaf()
+{
+	void* block = mLeafAllocator->allocate(sizeof(Leaf), alignof(Leaf));
+	try
+	{
+		return new (block) Leaf();
+
+	} catch(...) {
+
+		mLeafAllocator->deallocate(block);
+		throw;
+	}
+}
+
+/**
+* Allocates an empty inner node from the inner node pool.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+typename BPlusTree<Key, Value, NodeBytes>::Inner* BPlusTree<Key, Value, NodeBytes>::createInner()
+{
+	void* block = mInnerAllocator->allocate(sizeof(Inner), alignof(Inner));
+	try
+	{
+		return new (block) Inner();
+
+	} catch(...) {
+
+		mInnerAllocator->deallocate(block);
+		throw;
+	}
+}
+
+/**
+* Destroys a leaf and returns its block to the leaf pool.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::destroyNode(Leaf* leaf)
+{
+	leaf->~Leaf();
+	mLeafAllocator->deallocate(leaf);
+}
+
+/**
+* Destroys an inner node and returns its block to the inner node pool.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::destroyNode(Inner* inner)
+{
+	inner->~Inner();
+	mInnerAllocator->deallocate(inner);
+}
+
+/**
+* Destroys a subtree. The recursion is as deep as the tree is tall,
+* which stays small even for billions of items.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::helpClear(NodeBase* node)
+{
+	if(node->mLeaf)
+	{
+		destroyNode(static_cast<Leaf*>(node));
+		return;
+	}
+	Inner* inner = static_cast<Inner*>(node);
+	for(std::size_t i = 0; i <= inner->mCount; ++i)
+	{
+		helpClear(inner->mChildren[i]);
+	}
+	destroyNode(inner);
+}
+
+/**
+* Checks one subtree whose keys must lie in [low, high), where a null
+* bound is unbounded. Leaves are visited in key order, so each one must
+* be linked to the leaf visited before it.
+*/
+template <typename Key, typename Value, std::size_t NodeBytes>
+void BPlusTree<Key, Value, NodeBytes>::validateNode(const NodeBase* node, int depth, const Key* low, const Key* high,
+	TreeStats& stats, int& leafDepth, const Leaf*& prevLeaf) const
+{
+	std::size_t slots = node->mLeaf ? kLeafSlots : kInnerSlots;
+	std::size_t least = node == mRoot ? 1 : node->mLeaf ? kMinLeaf : kMinInner;
+	if(node->mCount < least || node->mCount > slots)
+	{
+		stats.balanced = false;
+	}
+
+	const Key* keys = node->mLeaf ? static_cast<const Leaf*>(node)->mKeys : static_cast<const Inner*>(node)->mKeys;
+	for(std::size_t i = 0; i < node->mCount; ++i)
+	{
+		if((i > 0 && !(keys[i - 1] < keys[i])) || (low && keys[i] < *low) || (high && !(keys[i] < *high)))
+		{
+			stats.ordered = false;
+		}
+	}
+
+	if(node->mLeaf)
+	{
+		const Leaf* leaf = static_cast<const Leaf*>(node);
+		if(leafDepth < 0)
+		{
+			leafDepth = depth;
+
+		} else if(leafDepth != depth) {
+
+			stats.balanced = false;
+		}
+		if(leaf->mPrev != prevLeaf || (prevLeaf ? prevLeaf->mNext != leaf : mFirst != leaf))
+		{
+			stats.linked = false;
+		}
+		prevLeaf = leaf;
+		stats.size += leaf->mCount;
+		return;
+	}
+
+	const Inner* inner = static_cast<const Inner*>(node);
+	for(std::size_t i = 0; i <= inner->mCount; ++i)
+	{
+		const Key* childLow = i == 0 ? low : &inner->mKeys[i - 1];
+		const Key* childHigh = i == inner->mCount ? high : &inner->mKeys[i];
+		validateNode(inner->mChildren[i], depth + 1, childLow, childHigh, stats, leafDepth, prevLeaf);
+	}
+}
+
+/*
+	--------------------------------------------
+	End implementations for the BPlusTree class.
+	--------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,153 @@
+#include "bplustree.h"
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+
+/*
+	Tests for BPlusTree: random inserts, overwrites and removes checked
+	against std::map after every step for lookups and bounds, and
+	periodically for iteration in both directions, copies and the tree's
+	own invariants. Numeric keys run once per vector search level the CPU
+	supports, so the SIMD node search is checked against the scalar one.
+*/
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	if(!ok)
+	{
+		std::printf("FAILED: %s\n", what);
+		++failures;
+	}
+}
+
+template<typename Key>
+static Key toKey(int i)
+{
+	return static_cast<Key>(i) - 1000;
+}
+
+template<>
+std::string toKey<std::string>(int i)
+{
+	return std::to_string(100000 + i);
+}
+
+/**
+* Returns true if the tree holds exactly the items of the map, walking
+* forwards from begin() and backwards from end().
+*/
+template<typename Tree, typename Map>
+static bool sameItems(const Tree& tree, const Map& expected)
+{
+	if(tree.size() != expected.size() || tree.empty() != expected.empty())
+	{
+		return false;
+	}
+	typename Tree::const_iterator it = tree.begin();
+	for(typename Map::const_iterator e = expected.begin(); e != expected.end(); ++e, ++it)
+	{
+		if(it == tree.end() || it->first != e->first || it->second != e->second)
+		{
+			return false;
+		}
+	}
+	if(it != tree.end())
+	{
+		return false;
+	}
+	for(typename Map::const_reverse_iterator e = expected.rbegin(); e != expected.rend(); ++e)
+	{
+		--it;
+		if(it->first != e->first)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+* Runs the random workload on one tree type. Keys are drawn from a small
+* range so that inserts often hit present keys and removes often empty
+* out whole nodes.
+*/
+template<typename Key, std::size_t NodeBytes>
+static void testAgainstMap(const char* name)
+{
+	typedef BPlusTree<Key, int, NodeBytes> Tree;
+	Tree tree;
+	std::map<Key, int> expected;
+	std::mt19937 rng(5);
+	bool ok = true;
+
+	for(int i = 0; i < 60000 && ok; ++i)
+	{
+		Key key = toKey<Key>(rng() % 4000);
+		if(rng() % 5 < 3)
+		{
+			tree.insert(std::make_pair(key, i));
+			expected[key] = i;
+
+		} else {
+
+			tree.remove(key);
+			expected.erase(key);
+		}
+
+		Key probe = toKey<Key>(rng() % 4000);
+		typename Tree::iterator found = tree.find(probe);
+		typename std::map<Key, int>::iterator match = expected.find(probe);
+		ok = (found == tree.end()) == (match == expected.end()) && (match == expected.end() || found->second == match->second);
+
+		typename Tree::iterator lower = tree.lower_bound(probe);
+		typename std::map<Key, int>::iterator lowerMatch = expected.lower_bound(probe);
+		ok = ok && (lower == tree.end()) == (lowerMatch == expected.end()) && (lowerMatch == expected.end() || lower->first == lowerMatch->first);
+
+		typename Tree::iterator upper = tree.upper_bound(probe);
+		typename std::map<Key, int>::iterator upperMatch = expected.upper_bound(probe);
+		ok = ok && (upper == tree.end()) == (upperMatch == expected.end()) && (upperMatch == expected.end() || upper->first == upperMatch->first);
+
+		std::pair<typename Tree::iterator, typename Tree::iterator> range = tree.equal_range(probe);
+		ok = ok && range.first == lower && range.second == upper;
+
+		if(i % 3000 == 0)
+		{
+			ok = ok && tree.validate().valid() && sameItems(tree, expected);
+
+			Tree copy(tree);
+			ok = ok && copy.validate().valid() && sameItems(copy, expected);
+			Tree moved(std::move(copy));
+			ok = ok && sameItems(moved, expected) && copy.empty();
+		}
+	}
+	ok = ok && tree.validate().valid() && sameItems(tree, expected);
+	check(ok, name);
+
+	tree.clear();
+	check(tree.empty() && tree.begin() == tree.end() && tree.validate().valid(), "clear");
+}
+
+int main()
+{
+	testAgainstMap<std::string, 128>("string keys, small nodes");
+
+	SimdLevel best = simdLevel();
+	for(int level = kSimdNone; level <= best; ++level)
+	{
+		simdLevel() = static_cast<SimdLevel>(level);
+		testAgainstMap<int, 256>("int keys");
+		testAgainstMap<std::int64_t, 256>("int64 keys");
+		testAgainstMap<double, 512>("double keys");
+	}
+	simdLevel() = best;
+
+	if(failures == 0)
+	{
+		std::printf("bplustree_test: all passed\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -5,19 +5,30 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <memory>
+#include <type_traits>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <tuple>
+#include <functional>
+#include "nodepool.h"
+#include "eytzinger.h"
 
 /**
-* A templated class for a Node in a search tree. The getters
-* for parent/left/right are virtual so that they
-* can be overridden for future kinds of search trees, 
-* such as Red Black trees, Splay trees, and AVL trees.
+* A templated class for a Node in a search tree. Nodes carry no vtable:
+* future kinds of search trees, such as Red Black trees, Splay trees, and
+* AVL trees, derive from Node and shadow the getters for parent/left/right
+* with versions returning their own node type, so every step of a
+* traversal is resolved at compile time and can be inlined.
 */
 template <typename Key, typename Value>
 class Node
 {
 public:
 	Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-	virtual ~Node();
+	Node(std::pair<Key, Value>&& item, Node<Key, Value>* parent);
+	~Node();
 
 	const std::pair<Key, Value>& getItem() const;
 	std::pair<Key, Value>& getItem();
@@ -26,14 +37,15 @@ public:
 	Key& getKey();
 	Value& getValue();
 
-	virtual Node<Key, Value>* getParent() const;
-	virtual Node<Key, Value>* getLeft() const;
-	virtual Node<Key, Value>* getRight() const;
+	Node<Key, Value>* getParent() const;
+	Node<Key, Value>* getLeft() const;
+	Node<Key, Value>* getRight() const;
 
 	void setParent(Node<Key, Value>* parent);
 	void setLeft(Node<Key, Value>* left);
 	void setRight(Node<Key, Value>* right);
 	void setValue(const Value &value);
+	void setValue(Value&& value);
 
 protected:
 	std::pair<Key, Value> mItem;
@@ -61,6 +73,19 @@ Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* par
 
 }
 
+/**
+* Constructor that moves an already built item into the node.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>::Node(std::pair<Key, Value>&& item, Node<Key, Value>* parent)
+	: mItem(std::move(item))
+	, mParent(parent)
+	, mLeft(NULL)
+	, mRight(NULL)
+{
+
+}
+
 /**
 * Destructor, which does not need to do anything since the pointers inside of a node
 * are only used as references to existing nodes. The nodes pointed to by parent/left/right
@@ -127,7 +152,7 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
@@ -136,7 +161,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -145,7 +170,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -189,12 +214,88 @@ void Node<Key, Value>::setValue(const Value& value)
 	mItem.second = value;
 }
 
+/**
+* A setter that moves a new value into the node.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+	mItem.second = std::move(value);
+}
+
 /*
 	---------------------------------------
 	End implementations for the Node class.
 	---------------------------------------
 */
 
+/**
+* Overload hook used by BinarySearchTree::validate() to compare the height
+* a node stores against the height measured for its subtree. Plain nodes
+* store no height, so they always match.
+*/
+template<typename Key, typename Value>
+bool heightMatches(const Node<Key, Value>*, int)
+{
+	return true;
+}
+
+/**
+* Overload hook used when a tree is assembled directly into shape to
+* record the height of a freshly built subtree. Plain nodes store no
+* height, so there is nothing to do.
+*/
+template<typename Key, typename Value>
+void storeHeight(Node<Key, Value>*, int)
+{
+
+}
+
+/**
+* Overload hooks for nodes that keep the size of their subtree. They are
+* called wherever the shape below a node changes; plain nodes keep no size,
+* so the first does nothing and the second always matches.
+*/
+template<typename Key, typename Value>
+void updateCount(Node<Key, Value>*)
+{
+
+}
+
+template<typename Key, typename Value>
+bool countMatches(const Node<Key, Value>*, std::size_t)
+{
+	return true;
+}
+
+/**
+* Overload hook that reports the number of nodes in the subtree below and
+* including a node, for nodes that keep it. Plain nodes keep no size, so
+* for them it returns false and leaves size alone.
+*/
+template<typename Key, typename Value>
+bool storedSize(const Node<Key, Value>*, std::size_t&)
+{
+	return false;
+}
+
+/**
+* The result of a single validation pass over a search tree.
+*/
+struct TreeStats
+{
+	bool balanced;		// every node's subtrees differ in height by at most one
+	bool ordered;		// keys strictly increase in an in-order walk
+	bool linked;		// every child points back at its parent
+	bool heightsValid;	// every stored height matches the measured one
+	bool countsValid;	// every stored subtree size matches the measured one
+	bool boundsValid;	// the cached smallest and largest items and item count are right
+	int height;			// number of nodes on the longest root-to-leaf path
+	std::size_t size;	// number of nodes
+
+	bool valid() const { return ordered && linked && heightsValid && countsValid && boundsValid; }
+};
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -203,21 +304,44 @@ class BinarySearchTree
 {
 	public:
 		BinarySearchTree(); //TODO
+		explicit BinarySearchTree(const std::shared_ptr<NodeAllocator>& allocator);
+		BinarySearchTree(const BinarySearchTree<Key, Value>& other);
+		BinarySearchTree(BinarySearchTree<Key, Value>&& other);
 		virtual ~BinarySearchTree(); //TODO
+		BinarySearchTree<Key, Value>& operator=(const BinarySearchTree<Key, Value>& other);
+		BinarySearchTree<Key, Value>& operator=(BinarySearchTree<Key, Value>&& other);
   		virtual void insert(const std::pair<Key, Value>& keyValuePair); //TODO
+		virtual void insert(std::pair<Key, Value>&& keyValuePair);
         virtual void remove(const Key& key); //TODO
   		void clear(); //TODO
+		std::size_t size() const;
+		bool empty() const;
   		void print() const;
   		bool isBalanced() const; //TODO
+  		TreeStats validate() const;
+		std::size_t structuralHash() const;
+		template<typename InputIterator>
+		void buildFromSorted(InputIterator first, InputIterator last);
+		template<typename InputIterator>
+		void build(InputIterator first, InputIterator last);
+		FrozenTree<Key, Value> freeze() const;
 
 	public:
 		/**
 		* An internal iterator class for traversing the contents of the BST.
+		* It walks in both directions; decrementing end() lands on the largest item.
 		*/
 		class iterator
 		{
 			public:
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef std::pair<Key, Value> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef std::pair<Key, Value>* pointer;
+				typedef std::pair<Key, Value>& reference;
+
 				iterator(Node<Key,Value>* ptr);
+				iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value>* tree);
 				iterator();
 
 				std::pair<Key,Value>& operator*() const;
@@ -225,42 +349,162 @@ class BinarySearchTree
 
 				bool operator==(const iterator& rhs) const;
 				bool operator!=(const iterator& rhs) const;
-				iterator& operator=(const iterator& rhs);
 
 				iterator& operator++();
+				iterator operator++(int);
+				iterator& operator--();
+				iterator operator--(int);
 
 			protected:
 				Node<Key, Value>* mCurrent;
+				const BinarySearchTree<Key, Value>* mTree;
 
 				friend class BinarySearchTree<Key, Value>;
 		};
 
+		/**
+		* An iterator that gives read-only access to the items.
+		*/
+		class const_iterator
+		{
+			public:
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef std::pair<Key, Value> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef const std::pair<Key, Value>* pointer;
+				typedef const std::pair<Key, Value>& reference;
+
+				const_iterator(const Node<Key,Value>* ptr, const BinarySearchTree<Key, Value>* tree);
+				const_iterator(const iterator& it);
+				const_iterator();
+
+				const std::pair<Key,Value>& operator*() const;
+				const std::pair<Key,Value>* operator->() const;
+
+				bool operator==(const const_iterator& rhs) const;
+				bool operator!=(const const_iterator& rhs) const;
+
+				const_iterator& operator++();
+				const_iterator operator++(int);
+				const_iterator& operator--();
+				const_iterator operator--(int);
+
+			protected:
+				const Node<Key, Value>* mCurrent;
+				const BinarySearchTree<Key, Value>* mTree;
+		};
+
+		typedef std::reverse_iterator<iterator> reverse_iterator;
+		typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
 	public:
-		iterator begin() const;
-		iterator end() const;
+		iterator begin();
+		iterator end();
+		const_iterator begin() const;
+		const_iterator end() const;
+		const_iterator cbegin() const;
+		const_iterator cend() const;
+		reverse_iterator rbegin();
+		reverse_iterator rend();
+		const_reverse_iterator rbegin() const;
+		const_reverse_iterator rend() const;
+		const_reverse_iterator crbegin() const;
+		const_reverse_iterator crend() const;
 		iterator find(const Key& key) const;
+		iterator lower_bound(const Key& key) const;
+		iterator upper_bound(const Key& key) const;
+		std::pair<iterator, iterator> equal_range(const Key& key) const;
+		iterator min() const;
+		iterator max() const;
+
+		// Removal straight from a node already in hand, with no search by key.
+		bool pop_min(std::pair<Key, Value>& item);
+		bool pop_max(std::pair<Key, Value>& item);
+		std::pair<Key, Value> extract(iterator pos);
+		iterator erase(iterator pos);
+
+		/**
+		* A pair of iterators over part of the tree, usable in range-based for loops.
+		*/
+		class iterator_range
+		{
+			public:
+				iterator_range(const iterator& first, const iterator& last);
+
+				iterator begin() const;
+				iterator end() const;
+
+			protected:
+				iterator mBegin;
+				iterator mEnd;
+		};
+
+		iterator_range range(const Key& low, const Key& high) const;
+
+		iterator insert(iterator hint, const std::pair<Key, Value>& keyValuePair);
+		iterator insert(iterator hint, std::pair<Key, Value>&& keyValuePair);
+		template<typename... Args>
+		std::pair<iterator, bool> emplace(Args&&... args);
+		template<typename... Args>
+		std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+		template<typename... Args>
+		std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+		template<typename M>
+		std::pair<iterator, bool> insert_or_assign(const Key& key, M&& value);
+		template<typename M>
+		std::pair<iterator, bool> insert_or_assign(Key&& key, M&& value);
 
 	protected:
 		Node<Key, Value>* internalFind(const Key& key) const; //TODO
+		Node<Key, Value>* internalBound(const Key& key, bool inclusive) const;
 		Node<Key, Value>* getSmallestNode() const; //TODO
+		Node<Key, Value>* getLargestNode() const;
+		static Node<Key, Value>* successor(const Node<Key, Value>* node);
+		static Node<Key, Value>* predecessor(const Node<Key, Value>* node);
 		void printRoot (Node<Key, Value>* root) const;
+		template<typename NodeType, typename... Args>
+		NodeType* createNode(Args&&... args);
+		template<typename NodeType>
+		void destroyNode(NodeType* node);
+		template<typename NodeType>
+		TreeStats validateNodes(NodeType* root) const;
+		Node<Key, Value>* findSlot(const Key& key, Node<Key, Value>*& parent) const;
+		Node<Key, Value>* findSlotNear(Node<Key, Value>* hint, const Key& key, Node<Key, Value>*& parent) const;
+		virtual Node<Key, Value>* attachItem(Node<Key, Value>* parent, std::pair<Key, Value>&& item);
+		virtual Node<Key, Value>* cloneRoot(const Node<Key, Value>* root);
+		template<typename NodeType>
+		NodeType* cloneNodes(const NodeType* root);
+		virtual void buildBalanced(std::vector<std::pair<Key, Value> >& items);
+		template<typename NodeType>
+		NodeType* buildRange(std::vector<std::pair<Key, Value> >& items,
+			std::size_t first, std::size_t last, NodeType* parent, int& height);
+		static void keepLastOfEachKey(std::vector<std::pair<Key, Value> >& items);
+		std::size_t helpClear(Node<Key,Value>* root);
+		void trackAttached(Node<Key, Value>* leaf);
+		void trackDetaching(Node<Key, Value>* node);
+		void resetBounds(std::size_t size);
+		virtual void removeNode(Node<Key, Value>* node);
 
 	protected:
 		Node<Key, Value>* mRoot;
+		std::shared_ptr<NodeAllocator> mAllocator;
+
+		// The leftmost and rightmost nodes and the number of nodes, kept
+		// current by every change so that begin(), min(), max() and size()
+		// take constant time. Operations that relink whole subtrees without
+		// counting them may leave the size as kUnknownSize, in which case
+		// size() counts the nodes once and remembers the result.
+		Node<Key, Value>* mFirst;
+		Node<Key, Value>* mLast;
+		mutable std::size_t mSize;
+		static const std::size_t kUnknownSize = static_cast<std::size_t>(-1);
 
 	public:
 		void print() {this->printRoot(this->mRoot);}
 	private:
-		void insertHelper(const std::pair<Key, Value>& keyValuePair,
-		Node<Key,Value>* root);
-		Node<Key, Value>* internalFindHelper(const Key& key,
-		Node<Key,Value>* root) const;
 		Node<Key, Value>* getPredecessor(Node<Key,Value>* root);
-		int checkHeight(Node<Key,Value>* root) const;
-		void helpClear(Node<Key,Value>* root);
-		bool returnBalanced(Node<Key,Value>* root) const;
 		void swapPred(Node<Key,Value>* remove ,Node<Key,Value>* pred);
-		void removeHelper(const Key& key, Node<Key,Value>* root);
+		void removeHelper(Node<Key,Value>* to_remove);
 };
 
 /*
@@ -271,10 +515,24 @@ class BinarySearchTree
 
 /**
 * Explicit constructor that initializes an iterator with a given node pointer.
+* Such an iterator cannot be decremented from end().
 */
 template<typename Key, typename Value>
 BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value>* ptr)
 	: mCurrent(ptr)
+	, mTree(NULL)
+{
+
+}
+
+/**
+* Constructor that also remembers the tree, so that the end iterator
+* can step back onto the largest item.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value>* tree)
+	: mCurrent(ptr)
+	, mTree(tree)
 {
 
 }
@@ -285,6 +543,7 @@ BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value>* ptr)
 template<typename Key, typename Value>
 BinarySearchTree<Key, Value>::iterator::iterator()
 	: mCurrent(NULL)
+	, mTree(NULL)
 {
 
 }
@@ -328,378 +587,1405 @@ bool BinarySearchTree<Key, Value>::iterator::operator!=(const BinarySearchTree<K
 }
 
 /**
-* Sets one iterator equal to another iterator.
+* Advances the iterator's location using an in-order traversal.
 */
 template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator &BinarySearchTree<Key, Value>::iterator::operator=(const BinarySearchTree<Key, Value>::iterator& rhs)
+typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::iterator::operator++()
 {
-	this->mCurrent = rhs.mCurrent;
+	mCurrent = successor(mCurrent);
 	return *this;
 }
 
 /**
-* Advances the iterator's location using an in-order traversal.
+* Advances the iterator, returning a copy of its old position.
 */
 template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::iterator::operator++()
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::iterator::operator++(int)
 {
-	if(mCurrent->getRight() != NULL)
-	{
-		mCurrent = mCurrent->getRight();
-		while(mCurrent->getLeft() != NULL)
-		{
-			mCurrent = mCurrent->getLeft();
-		}
-	}
-	else if(mCurrent->getRight() == NULL)
-	{
-		Node<Key, Value>* parent = mCurrent->getParent();
-		while(parent != NULL && mCurrent == parent->getRight())
-		{
-			mCurrent = parent;
-			parent = parent->getParent();
-		}
-		mCurrent = parent;
-	}
-	return *this;
+	iterator old(*this);
+	++(*this);
+	return old;
 }
 
-/*
-	-------------------------------------------------------------
-	End implementations for the BinarySearchTree::iterator class.
-	-------------------------------------------------------------
+/**
+* Moves the iterator back to the previous item in key order. The end
+* iterator moves back to the largest item.
 */
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator& BinarySearchTree<Key, Value>::iterator::operator--()
+{
+	mCurrent = mCurrent ? predecessor(mCurrent) : mTree->getLargestNode();
+	return *this;
+}
 
-/*
-	-----------------------------------------------------
-	Begin implementations for the BinarySearchTree class.
-	-----------------------------------------------------
+/**
+* Moves the iterator back, returning a copy of its old position.
 */
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::iterator::operator--(int)
+{
+	iterator old(*this);
+	--(*this);
+	return old;
+}
 
 /**
-* Default constructor for a BinarySearchTree, which sets the root to NULL.
+* Explicit constructor that initializes a const_iterator with a given node pointer.
 */
 template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::BinarySearchTree()
+BinarySearchTree<Key, Value>::const_iterator::const_iterator(const Node<Key,Value>* ptr, const BinarySearchTree<Key, Value>* tree)
+	: mCurrent(ptr)
+	, mTree(tree)
 {
-	mRoot = nullptr;
+
 }
 
+/**
+* Converts a mutable iterator into a read-only one.
+*/
 template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+BinarySearchTree<Key, Value>::const_iterator::const_iterator(const iterator& it)
+	: mCurrent(it.mCurrent)
+	, mTree(it.mTree)
 {
-	clear();
+
 }
 
+/**
+* A default constructor that initializes the const_iterator to NULL.
+*/
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+BinarySearchTree<Key, Value>::const_iterator::const_iterator()
+	: mCurrent(NULL)
+	, mTree(NULL)
 {
-	printRoot(mRoot);
-	std::cout << "\n";
+
 }
 
 /**
-* Returns an iterator to the "smallest" item in the tree
+* Provides read-only access to the item.
 */
 template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::begin() const
+const std::pair<Key, Value>& BinarySearchTree<Key, Value>::const_iterator::operator*() const
 {
-	BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
-	return begin;
+	return mCurrent->getItem();
 }
+
 /**
-* Returns an iterator whose value means INVALID
+* Provides the address of the item.
 */
 template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::end() const
+const std::pair<Key, Value>* BinarySearchTree<Key, Value>::const_iterator::operator->() const
 {
-	BinarySearchTree<Key, Value>::iterator end(nullptr);
-	return end;
+	return &(mCurrent->getItem());
 }
 
 /**
-* Returns an iterator to the item with the given key, k
-* or the end iterator if k does not exist in the tree
+* Checks if 'this' const_iterator points at the same node as 'rhs'
 */
 template<typename Key, typename Value>
-typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::find(const Key& key) const
+bool BinarySearchTree<Key, Value>::const_iterator::operator==(const BinarySearchTree<Key, Value>::const_iterator& rhs) const
 {
-	Node<Key, Value>* curr = internalFind(key);
-	BinarySearchTree<Key, Value>::iterator it(curr);
-	return it;
+	return this->mCurrent == rhs.mCurrent;
 }
 
 /**
-* An insert method to insert into a Binary Search Tree. The tree will not remain balanced when
-* inserting.
+* Checks if 'this' const_iterator points at a different node than 'rhs'
 */
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+bool BinarySearchTree<Key, Value>::const_iterator::operator!=(const BinarySearchTree<Key, Value>::const_iterator& rhs) const
 {
-	if(mRoot == nullptr) 
-	{
-		Node<Key,Value>* leaf = new Node<Key,Value>(keyValuePair.first, keyValuePair.second, nullptr);
-		mRoot = leaf;
-		
-	} else {
-		insertHelper(keyValuePair, mRoot);
-	}
+	return this->mCurrent != rhs.mCurrent;
 }
 
 /**
-* A helper method that recursively finds the node at which to insert,
-* creates a node, and sets the parents/children accordingly. 
+* Advances the const_iterator's location using an in-order traversal.
 */
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::insertHelper(const std::pair<Key, Value>& keyValuePair, Node<Key,Value>* root) 
+typename BinarySearchTree<Key, Value>::const_iterator& BinarySearchTree<Key, Value>::const_iterator::operator++()
 {
-	if(keyValuePair.first < root->getKey()) 
-	{
-		if(root->getLeft() == nullptr) 
-		{
-			Node<Key,Value>* leaf = new Node<Key,Value>(keyValuePair.first, keyValuePair.second, root);
-			root->setLeft(leaf);
-
-		} else {
-
-			insertHelper(keyValuePair, root->getLeft());
-		}
-	} 
-	else if(keyValuePair.first > root->getKey()) 
-	{
-		if(root->getRight() == nullptr) 
-		{
-			Node<Key,Value>* leaf = new Node<Key,Value>(keyValuePair.first, keyValuePair.second, root);
-			root->setRight(leaf);
-		} 
-		else 
-		{
-			insertHelper(keyValuePair, root->getRight());
-		}
-	} 
-	else 
-	{
-		root->setValue(keyValuePair.second);
-	}
+	mCurrent = successor(mCurrent);
+	return *this;
 }
 
 /**
-* A remove method to remove a specific key from 
-* a Binary Search Tree. The tree may not remain 
-* balanced after removal.
+* Advances the const_iterator, returning a copy of its old position.
 */
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
-{	
-	Node<Key,Value>* to_remove = internalFind(key);
- 	removeHelper(key, to_remove);
+typename BinarySearchTree<Key, Value>::const_iterator BinarySearchTree<Key, Value>::const_iterator::operator++(int)
+{
+	const_iterator old(*this);
+	++(*this);
+	return old;
 }
 
-/** 
- * Helper function for remove that takes in the 
- * node directly and decides how to remove it.
- */
+/**
+* Moves the const_iterator back to the previous item in key order. The end
+* iterator moves back to the largest item.
+*/
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::removeHelper(const Key& key, Node<Key,Value>* to_remove) 
+typename BinarySearchTree<Key, Value>::const_iterator& BinarySearchTree<Key, Value>::const_iterator::operator--()
 {
+	mCurrent = mCurrent ? predecessor(mCurrent) : mTree->getLargestNode();
+	return *this;
+}
 
-	if(to_remove == nullptr) {
-		return;
-	}
+/**
+* Moves the const_iterator back, returning a copy of its old position.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::const_iterator BinarySearchTree<Key, Value>::const_iterator::operator--(int)
+{
+	const_iterator old(*this);
+	--(*this);
+	return old;
+}
 
-	if(!to_remove->getRight() && !to_remove->getLeft()) 
-	{
-		if(mRoot == to_remove) 
-		{
-			mRoot = nullptr;
+/*
+	-------------------------------------------------------------
+	End implementations for the BinarySearchTree::iterator class.
+	-------------------------------------------------------------
+*/
 
-		} else { 	
+/**
+* Constructor for a range spanning [first, last).
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::iterator_range::iterator_range(const iterator& first, const iterator& last)
+	: mBegin(first)
+	, mEnd(last)
+{
 
-			if(to_remove->getParent()->getLeft() == to_remove) 
-			{
-				to_remove->getParent()->setLeft(nullptr);
+}
 
-			} else {
+/**
+* Returns an iterator to the first item in the range.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::iterator_range::begin() const
+{
+	return mBegin;
+}
 
-				to_remove->getParent()->setRight(nullptr);
-			}
-		}
-		delete to_remove;
-	} 
-	else if(!to_remove->getRight()) 
-	{
+/**
+* Returns an iterator just past the last item in the range.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::iterator_range::end() const
+{
+	return mEnd;
+}
 
-		Node<Key,Value>* parent = to_remove->getParent();
-		if(parent == nullptr) 
-		{
-			Node<Key,Value>* child = to_remove->getLeft();
-			to_remove->setLeft(nullptr);
-			mRoot = child;
-			child->setParent(nullptr);
-			
-		}
-		else if(parent->getLeft() == to_remove) 
-		{
-			parent->setLeft(to_remove->getLeft());
-			parent->getLeft()->setParent(parent);
+/*
+	-----------------------------------------------------
+	Begin implementations for the BinarySearchTree class.
+	-----------------------------------------------------
+*/
 
-		} else {
+/**
+* Default constructor for a BinarySearchTree, which sets the root to NULL.
+* Nodes are drawn from a pool owned by this tree.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::BinarySearchTree()
+	: mAllocator(std::make_shared<NodePool>())
+	, mFirst(nullptr)
+	, mLast(nullptr)
+	, mSize(0)
+{
+	mRoot = nullptr;
+}
 
-			parent->setRight(to_remove->getLeft());
-			parent->getRight()->setParent(parent);
-		}
+/**
+* Constructor that draws nodes from the given allocator, which may be
+* shared with other trees.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(const std::shared_ptr<NodeAllocator>& allocator)
+	: mAllocator(allocator)
+	, mFirst(nullptr)
+	, mLast(nullptr)
+	, mSize(0)
+{
+	mRoot = nullptr;
+}
 
-		delete to_remove;
-	} 
-	else if(!to_remove->getLeft()) 
-	{
-		Node<Key,Value>* parent = to_remove->getParent();
-		if(parent == nullptr) 
-		{
-			Node<Key,Value>* child = to_remove->getRight();
-			to_remove->setRight(nullptr);
-			mRoot = child;
-			child->setParent(nullptr);
+/**
+* Copy constructor. The copy has the same shape as the original and 
+* draws its nodes from a pool of its own.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(const BinarySearchTree<Key, Value>& other)
+	: mAllocator(std::make_shared<NodePool>())
+{
+	mRoot = cloneRoot(other.mRoot);
+	resetBounds(other.mSize);
+}
 
-		} else {
+/**
+* Move constructor, which takes over the nodes and allocator of the other 
+* tree and leaves it empty with a fresh pool.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::BinarySearchTree(BinarySearchTree<Key, Value>&& other)
+	: mAllocator(std::make_shared<NodePool>())
+	, mFirst(other.mFirst)
+	, mLast(other.mLast)
+	, mSize(other.mSize)
+{
+	mRoot = other.mRoot;
+	other.mRoot = nullptr;
+	other.resetBounds(0);
+	std::swap(mAllocator, other.mAllocator);
+}
 
-			if(parent->getLeft() == to_remove) 
+/**
+* Copy assignment, which replaces the contents with a copy of the other tree.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>& BinarySearchTree<Key, Value>::operator=(const BinarySearchTree<Key, Value>& other)
+{
+	if(this != &other) 
+	{
+		clear();
+		mRoot = cloneRoot(other.mRoot);
+		resetBounds(other.mSize);
+	}
+	return *this;
+}
+
+/**
+* Move assignment, which frees the current contents and swaps the 
+* now empty tree with the other one.
+*/
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>& BinarySearchTree<Key, Value>::operator=(BinarySearchTree<Key, Value>&& other)
+{
+	if(this != &other) 
+	{
+		clear();
+		std::swap(mRoot, other.mRoot);
+		std::swap(mFirst, other.mFirst);
+		std::swap(mLast, other.mLast);
+		std::swap(mSize, other.mSize);
+		std::swap(mAllocator, other.mAllocator);
+	}
+	return *this;
+}
+
+template<typename Key, typename Value>
+BinarySearchTree<Key, Value>::~BinarySearchTree()
+{
+	clear();
+}
+
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::print() const
+{
+	printRoot(mRoot);
+	std::cout << "\n";
+}
+
+/**
+* Returns an iterator to the "smallest" item in the tree, in constant time
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::begin()
+{
+	return iterator(getSmallestNode(), this);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::end()
+{
+	return iterator(nullptr, this);
+}
+
+/**
+* Returns a read-only iterator to the "smallest" item in the tree
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::const_iterator BinarySearchTree<Key, Value>::begin() const
+{
+	return const_iterator(getSmallestNode(), this);
+}
+
+/**
+* Returns a read-only iterator whose value means INVALID
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::const_iterator BinarySearchTree<Key, Value>::end() const
+{
+	return const_iterator(nullptr, this);
+}
+
+/**
+* Same as begin() const, even on a mutable tree.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::const_iterator BinarySearchTree<Key, Value>::cbegin() const
+{
+	return begin();
+}
+
+/**
+* Same as end() const, even on a mutable tree.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::const_iterator BinarySearchTree<Key, Value>::cend() const
+{
+	return end();
+}
+
+/**
+* Returns a reverse iterator to the "largest" item in the tree
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::reverse_iterator BinarySearchTree<Key, Value>::rbegin()
+{
+	return reverse_iterator(end());
+}
+
+/**
+* Returns the reverse iterator past the "smallest" item in the tree
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::reverse_iterator BinarySearchTree<Key, Value>::rend()
+{
+	return reverse_iterator(begin());
+}
+
+/**
+* Returns a read-only reverse iterator to the "largest" item in the tree
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::const_reverse_iterator BinarySearchTree<Key, Value>::rbegin() const
+{
+	return const_reverse_iterator(end());
+}
+
+/**
+* Returns the read-only reverse iterator past the "smallest" item in the tree
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::const_reverse_iterator BinarySearchTree<Key, Value>::rend() const
+{
+	return const_reverse_iterator(begin());
+}
+
+/**
+* Same as rbegin() const, even on a mutable tree.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::const_reverse_iterator BinarySearchTree<Key, Value>::crbegin() const
+{
+	return rbegin();
+}
+
+/**
+* Same as rend() const, even on a mutable tree.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::const_reverse_iterator BinarySearchTree<Key, Value>::crend() const
+{
+	return rend();
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::find(const Key& key) const
+{
+	Node<Key, Value>* curr = internalFind(key);
+	BinarySearchTree<Key, Value>::iterator it(curr, this);
+	return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than the
+* given key, or the end iterator if there is none.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::lower_bound(const Key& key) const
+{
+	return iterator(internalBound(key, true), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than the
+* given key, or the end iterator if there is none.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::upper_bound(const Key& key) const
+{
+	return iterator(internalBound(key, false), this);
+}
+
+/**
+* Returns the range of items matching the given key, which holds
+* at most one item since keys are unique.
+*/
+template<typename Key, typename Value>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, typename BinarySearchTree<Key, Value>::iterator> 
+BinarySearchTree<Key, Value>::equal_range(const Key& key) const
+{
+	Node<Key, Value>* first = internalBound(key, true);
+	if(first == nullptr || key < first->getKey()) 
+	{
+		return std::make_pair(iterator(first, this), iterator(first, this));
+	}
+	iterator last(first, this);
+	++last;
+	return std::make_pair(iterator(first, this), last);
+}
+
+/**
+* Returns an iterator to the item with the smallest key, or the end
+* iterator if the tree is empty. The node is cached, so this takes O(1).
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::min() const
+{
+	return iterator(mFirst, this);
+}
+
+/**
+* Returns an iterator to the item with the largest key, or the end
+* iterator if the tree is empty. The node is cached, so this takes O(1).
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::max() const
+{
+	return iterator(mLast, this);
+}
+
+/**
+* Returns the items with low <= key < high in key order. Finding the ends
+* costs O(log n) and walking between them O(1) amortized per item.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator_range BinarySearchTree<Key, Value>::range(const Key& low, const Key& high) const
+{
+	if(!(low < high)) 
+	{
+		return iterator_range(iterator(nullptr, this), iterator(nullptr, this));
+	}
+	return iterator_range(lower_bound(low), lower_bound(high));
+}
+
+/**
+* Returns a read-only snapshot of the items in Eytzinger order, built in
+* O(n) from an in-order walk. Lookups in the snapshot are several times
+* faster than in the tree, and it stays valid while the tree changes.
+*/
+template<typename Key, typename Value>
+FrozenTree<Key, Value> BinarySearchTree<Key, Value>::freeze() const
+{
+	return FrozenTree<Key, Value>(begin(), end());
+}
+
+/**
+* An insert method to insert into a Binary Search Tree. The tree will not remain balanced when
+* inserting. If the key is already present its value is overwritten.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+	Node<Key, Value>* parent = nullptr;
+	Node<Key, Value>* found = findSlot(keyValuePair.first, parent);
+	if(found) 
+	{
+		found->setValue(keyValuePair.second);
+
+	} else {
+
+		attachItem(parent, std::pair<Key, Value>(keyValuePair));
+	}
+}
+
+/**
+* An insert method that moves the item into the tree instead of copying it,
+* or moves just the value over the existing one if the key is present.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+	Node<Key, Value>* parent = nullptr;
+	Node<Key, Value>* found = findSlot(keyValuePair.first, parent);
+	if(found) 
+	{
+		found->setValue(std::move(keyValuePair.second));
+
+	} else {
+
+		attachItem(parent, std::move(keyValuePair));
+	}
+}
+
+/**
+* Inserts an item, or overwrites the value if the key is present, looking
+* first next to the hint: an iterator to the item just before or after
+* where the key belongs, or end() to append. A good hint saves the walk
+* down from the root. Returns an iterator to the item for the key.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::insert(iterator hint, const std::pair<Key, Value>& keyValuePair)
+{
+	return insert(hint, std::pair<Key, Value>(keyValuePair));
+}
+
+/**
+* Hinted insert that moves the item, or just its value, into the tree.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::insert(iterator hint, std::pair<Key, Value>&& keyValuePair)
+{
+	Node<Key, Value>* parent = nullptr;
+	Node<Key, Value>* found = findSlotNear(hint.mCurrent, keyValuePair.first, parent);
+	if(found) 
+	{
+		found->setValue(std::move(keyValuePair.second));
+		return iterator(found, this);
+	}
+	return iterator(attachItem(parent, std::move(keyValuePair)), this);
+}
+
+/**
+* Builds an item from the arguments and inserts it unless its key is 
+* already present, in which case the tree is left unchanged. Returns 
+* an iterator to the item with that key and whether it was inserted.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool> BinarySearchTree<Key, Value>::emplace(Args&&... args)
+{
+	std::pair<Key, Value> item(std::forward<Args>(args)...);
+	Node<Key, Value>* parent = nullptr;
+	Node<Key, Value>* found = findSlot(item.first, parent);
+	if(found) 
+	{
+		return std::make_pair(iterator(found, this), false);
+	}
+	return std::make_pair(iterator(attachItem(parent, std::move(item)), this), true);
+}
+
+/**
+* Inserts an item whose value is built from the arguments, but only if
+* the key is absent. Nothing is constructed when the key is present.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool> BinarySearchTree<Key, Value>::try_emplace(const Key& key, Args&&... args)
+{
+	Node<Key, Value>* parent = nullptr;
+	Node<Key, Value>* found = findSlot(key, parent);
+	if(found) 
+	{
+		return std::make_pair(iterator(found, this), false);
+	}
+	std::pair<Key, Value> item(std::piecewise_construct, std::forward_as_tuple(key), 
+		std::forward_as_tuple(std::forward<Args>(args)...));
+	return std::make_pair(iterator(attachItem(parent, std::move(item)), this), true);
+}
+
+/**
+* Same as above, moving the key into the tree when it is inserted.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool> BinarySearchTree<Key, Value>::try_emplace(Key&& key, Args&&... args)
+{
+	Node<Key, Value>* parent = nullptr;
+	Node<Key, Value>* found = findSlot(key, parent);
+	if(found) 
+	{
+		return std::make_pair(iterator(found, this), false);
+	}
+	std::pair<Key, Value> item(std::piecewise_construct, std::forward_as_tuple(std::move(key)), 
+		std::forward_as_tuple(std::forward<Args>(args)...));
+	return std::make_pair(iterator(attachItem(parent, std::move(item)), this), true);
+}
+
+/**
+* Inserts the item, or assigns the value to the existing item with the
+* key. Returns an iterator to the item and whether it was inserted.
+*/
+template<typename Key, typename Value>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool> BinarySearchTree<Key, Value>::insert_or_assign(const Key& key, M&& value)
+{
+	Node<Key, Value>* parent = nullptr;
+	Node<Key, Value>* found = findSlot(key, parent);
+	if(found) 
+	{
+		found->getValue() = std::forward<M>(value);
+		return std::make_pair(iterator(found, this), false);
+	}
+	std::pair<Key, Value> item(key, std::forward<M>(value));
+	return std::make_pair(iterator(attachItem(parent, std::move(item)), this), true);
+}
+
+/**
+* Same as above, moving the key into the tree when it is inserted.
+*/
+template<typename Key, typename Value>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool> BinarySearchTree<Key, Value>::insert_or_assign(Key&& key, M&& value)
+{
+	Node<Key, Value>* parent = nullptr;
+	Node<Key, Value>* found = findSlot(key, parent);
+	if(found) 
+	{
+		found->getValue() = std::forward<M>(value);
+		return std::make_pair(iterator(found, this), false);
+	}
+	std::pair<Key, Value> item(std::move(key), std::forward<M>(value));
+	return std::make_pair(iterator(attachItem(parent, std::move(item)), this), true);
+}
+
+/**
+* Walks down from the root looking for a key. Returns the node holding it,
+* or NULL with parent set to the node a new leaf for the key belongs under
+* (NULL as well when the tree is empty). Keys beyond either end of the tree
+* go straight under the cached smallest or largest node, so increasing or
+* decreasing runs of inserts need no walk at all.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findSlot(const Key& key, Node<Key, Value>*& parent) const
+{
+	if(mLast != nullptr && mLast->getKey() < key) 
+	{
+		parent = mLast;
+		return nullptr;
+	}
+	if(mFirst != nullptr && key < mFirst->getKey()) 
+	{
+		parent = mFirst;
+		return nullptr;
+	}
+
+	parent = nullptr;
+	Node<Key, Value>* curr = mRoot;
+	while(curr != nullptr) 
+	{
+		if(key < curr->getKey()) 
+		{
+			parent = curr;
+			curr = curr->getLeft();
+		} 
+		else if(curr->getKey() < key) 
+		{
+			parent = curr;
+			curr = curr->getRight();
+		} 
+		else 
+		{
+			return curr;
+		}
+	}
+	return nullptr;
+}
+
+/**
+* Like findSlot(), but checks first whether the key belongs right next to
+* the hint, a node of this tree or NULL for the end. The new leaf then goes
+* under whichever of the hint and its neighbour has the free child pointer
+* facing the key. Falls back to the walk from the root otherwise.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findSlotNear(Node<Key, Value>* hint, const Key& key, Node<Key, Value>*& parent) const
+{
+	if(hint == nullptr) 
+	{
+		return findSlot(key, parent);
+	}
+
+	if(key < hint->getKey()) 
+	{
+		Node<Key, Value>* prev = hint == mFirst ? nullptr : predecessor(hint);
+		if(prev == nullptr || prev->getKey() < key) 
+		{
+			parent = hint->getLeft() ? prev : hint;
+			return nullptr;
+		}
+	} 
+	else if(hint->getKey() < key) 
+	{
+		Node<Key, Value>* next = hint == mLast ? nullptr : successor(hint);
+		if(next == nullptr || key < next->getKey()) 
+		{
+			parent = hint->getRight() ? next : hint;
+			return nullptr;
+		}
+	} 
+	else 
+	{
+		return hint;
+	}
+	return findSlot(key, parent);
+}
+
+/**
+* Creates a leaf for an item whose key is absent and hangs it below the
+* parent found by findSlot(). Trees that keep themselves balanced override
+* this to create their own kind of node and rebalance afterwards.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::attachItem(Node<Key, Value>* parent, std::pair<Key, Value>&& item)
+{
+	Node<Key, Value>* leaf = createNode<Node<Key, Value> >(std::move(item), parent);
+	if(parent == nullptr) 
+	{
+		mRoot = leaf;
+	} 
+	else if(leaf->getKey() < parent->getKey()) 
+	{
+		parent->setLeft(leaf);
+	} 
+	else 
+	{
+		parent->setRight(leaf);
+	}
+	trackAttached(leaf);
+	return leaf;
+}
+
+/**
+* A remove method to remove a specific key from 
+* a Binary Search Tree. The tree may not remain 
+* balanced after removal.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::remove(const Key& key)
+{	
+	Node<Key,Value>* to_remove = internalFind(key);
+ 	removeHelper(to_remove);
+}
+
+/** 
+ * Helper function for remove that takes in the 
+ * node directly and unlinks it. A node with two
+ * children is first swapped with its predecessor
+ * so that it has at most one child, which then
+ * takes its place.
+ */
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::removeHelper(Node<Key,Value>* to_remove) 
+{
+	if(to_remove == nullptr) {
+		return;
+	}
+
+	if(to_remove->getLeft() && to_remove->getRight()) 
+	{
+		swapPred(to_remove, getPredecessor(to_remove));
+	}
+	trackDetaching(to_remove);
+
+	Node<Key,Value>* parent = to_remove->getParent();
+	Node<Key,Value>* child = to_remove->getLeft() ? to_remove->getLeft() : to_remove->getRight();
+
+	if(child) 
+	{
+		child->setParent(parent);
+	}
+
+	if(parent == nullptr) 
+	{
+		mRoot = child;
+
+	} else if(parent->getLeft() == to_remove) {
+
+		parent->setLeft(child);
+
+	} else {
+
+		parent->setRight(child);
+	}
+
+	destroyNode(to_remove);
+}
+
+/** 
+ * Swaps a node with it's predecessor.
+ */
+template<typename Key, typename Value>
+void BinarySearchTree<Key,Value>::swapPred(Node<Key,Value>* remove , Node<Key,Value>* pred)
+{
+
+	bool root = false;
+	bool remove_right = false;
+	bool remove_left = false;
+
+	Node<Key,Value>* new_pred_parent = remove->getParent();
+    Node<Key,Value>* new_pred_left = remove->getLeft();
+    Node<Key,Value>* new_pred_right = remove->getRight();
+    Node<Key,Value>* new_remove_parent = pred->getParent();
+    Node<Key,Value>* new_remove_left = pred->getLeft();
+    Node<Key,Value>* new_remove_right = nullptr;
+
+    if(pred->getParent() == remove) {
+		new_remove_parent = pred;
+		new_pred_left = remove; 
+	}
+	
+	if(remove->getParent()) {
+		if(remove->getParent()->getRight() == remove) 
+		{
+			remove_right = true;
+
+		} else {
+
+			remove_left = true;
+		}
+	} else {
+
+		root = true;
+	}
+
+	remove->setParent(new_remove_parent);
+	remove->setLeft(new_remove_left);
+	remove->setRight(new_remove_right);
+
+	if(pred->getParent()->getRight() == pred) {
+		
+		remove->getParent()->setRight(remove);
+		
+	} else if(pred->getParent()->getLeft() == pred) {
+
+		remove->getParent()->setRight(remove);
+	}
+
+	if(remove->getLeft()) 
+	{
+		remove->getLeft()->setParent(remove);
+	}
+
+	pred->setParent(new_pred_parent);
+	pred->setLeft(new_pred_left);
+	pred->setRight(new_pred_right);
+	pred->getLeft()->setParent(pred);
+	pred->getRight()->setParent(pred);
+
+	if(remove_right) {
+		pred->getParent()->setRight(pred);
+	} else if(remove_left) {
+		pred->getParent()->setLeft(pred);
+	}
+	
+	if(root) {
+		mRoot = pred;
+	} 
+} 
+
+/**
+* A method to remove all contents of the tree and reset the values in the tree
+* for use again. When the tree is the only user of its allocator and the items
+* need no destructor, the whole pool is dropped at once instead of walking
+* the tree.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::clear()
+{	
+	if(mRoot == nullptr) 
+	{
+		return;
+	}
+	if(!std::is_trivially_destructible<std::pair<Key, Value> >::value 
+		|| mAllocator.use_count() != 1 || !mAllocator->release()) 
+	{
+		helpClear(mRoot);
+	}
+	mRoot = nullptr;
+	resetBounds(0);
+}
+
+/**
+* Moves the item with the smallest key out into item and removes its node,
+* which is cached, so no search is needed. Returns false, leaving item
+* alone, if the tree is empty.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::pop_min(std::pair<Key, Value>& item)
+{
+	if(mFirst == nullptr) 
+	{
+		return false;
+	}
+	item = std::move(mFirst->getItem());
+	removeNode(mFirst);
+	return true;
+}
+
+/**
+* Moves the item with the largest key out into item and removes its node.
+* Returns false, leaving item alone, if the tree is empty.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::pop_max(std::pair<Key, Value>& item)
+{
+	if(mLast == nullptr) 
+	{
+		return false;
+	}
+	item = std::move(mLast->getItem());
+	removeNode(mLast);
+	return true;
+}
+
+/**
+* Removes the item an iterator points at and returns it. The iterator must
+* point at an item of this tree, and is invalidated along with it.
+*/
+template<typename Key, typename Value>
+std::pair<Key, Value> BinarySearchTree<Key, Value>::extract(iterator pos)
+{
+	std::pair<Key, Value> item(std::move(pos.mCurrent->getItem()));
+	removeNode(pos.mCurrent);
+	return item;
+}
+
+/**
+* Removes the item an iterator points at and returns an iterator to the
+* item after it. Nodes are relinked rather than having their items moved
+* around, so iterators to every other item stay valid.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator BinarySearchTree<Key, Value>::erase(iterator pos)
+{
+	Node<Key, Value>* next = successor(pos.mCurrent);
+	removeNode(pos.mCurrent);
+	return iterator(next, this);
+}
+
+/**
+* Unlinks and frees a node of this tree. Trees that keep themselves
+* balanced override this to use their own removal, which rebalances.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::removeNode(Node<Key, Value>* node)
+{
+	removeHelper(node);
+}
+
+/**
+* Returns the number of items in the tree. This takes O(1) unless an
+* operation that relinks whole subtrees left the count unknown, in which
+* case the nodes are counted once.
+*/
+template<typename Key, typename Value>
+std::size_t BinarySearchTree<Key, Value>::size() const
+{
+	if(mSize == kUnknownSize) 
+	{
+		mSize = 0;
+		for(const_iterator it = begin(); it != end(); ++it) 
+		{
+			++mSize;
+		}
+	}
+	return mSize;
+}
+
+/**
+* Returns true if the tree holds no items.
+*/
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::empty() const
+{
+	return mRoot == nullptr;
+}
+
+/**
+* Destroys every node below and including root without recursing and 
+* returns how many there were. Leaves are detached from their parent and
+* freed, and the walk then climbs back up through the parent pointer, so
+* root must not have a parent.
+*/
+template<typename Key, typename Value>
+std::size_t BinarySearchTree<Key, Value>::helpClear(Node<Key,Value>* root)
+{
+	std::size_t count = 0;
+	while(root != nullptr) 
+	{
+		if(root->getLeft()) 
+		{
+			root = root->getLeft();
+		} 
+		else if(root->getRight()) 
+		{
+			root = root->getRight();
+		} 
+		else 
+		{
+			Node<Key,Value>* parent = root->getParent();
+			if(parent) 
 			{
-				parent->setLeft(to_remove->getRight());
-				parent->getLeft()->setParent(parent);
+				if(parent->getLeft() == root) 
+				{
+					parent->setLeft(nullptr);
+
+				} else {
+
+					parent->setRight(nullptr);
+				}
+			}
+			destroyNode(root);
+			++count;
+			root = parent;
+		}
+	}
+	return count;
+}
+
+/**
+* Brings the cached bounds and size up to date after a new leaf has been
+* linked into the tree. A new leaf is the smallest node exactly when it
+* hangs to the left of the old smallest one, and likewise for the largest.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::trackAttached(Node<Key, Value>* leaf)
+{
+	if(mFirst == nullptr || mFirst->getLeft() == leaf) 
+	{
+		mFirst = leaf;
+	}
+	if(mLast == nullptr || mLast->getRight() == leaf) 
+	{
+		mLast = leaf;
+	}
+	if(mSize != kUnknownSize) 
+	{
+		++mSize;
+	}
+}
+
+/**
+* Brings the cached bounds and size up to date before a node with at most
+* one child is unlinked from the tree. The smallest node has no left child,
+* so its successor is found within a step or a walk down its right child,
+* and likewise for the largest.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::trackDetaching(Node<Key, Value>* node)
+{
+	if(node == mFirst) 
+	{
+		mFirst = successor(node);
+	}
+	if(node == mLast) 
+	{
+		mLast = predecessor(node);
+	}
+	if(mSize != kUnknownSize) 
+	{
+		--mSize;
+	}
+}
+
+/**
+* Finds the smallest and largest nodes afresh by walking down from the root,
+* for use after whole subtrees were relinked, and records the given size,
+* which may be kUnknownSize.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::resetBounds(std::size_t size)
+{
+	mFirst = mRoot;
+	while(mFirst != nullptr && mFirst->getLeft() != nullptr) 
+	{
+		mFirst = mFirst->getLeft();
+	}
+	mLast = mRoot;
+	while(mLast != nullptr && mLast->getRight() != nullptr) 
+	{
+		mLast = mLast->getRight();
+	}
+	mSize = size;
+}
+
+/**
+* Constructs a node in memory obtained from the tree's allocator, passing
+* the arguments on to the node's constructor.
+*/
+template<typename Key, typename Value>
+template<typename NodeType, typename... Args>
+NodeType* BinarySearchTree<Key, Value>::createNode(Args&&... args)
+{
+	void* block = mAllocator->allocate(sizeof(NodeType), alignof(NodeType));
+	try 
+	{
+		return new (block) NodeType(std::forward<Args>(args)...);
+
+	} catch(...) {
+
+		mAllocator->deallocate(block);
+		throw;
+	}
+}
+
+/**
+* Copies a tree of plain nodes. Trees with their own kind of node
+* override this so that copies are made of that node type.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::cloneRoot(const Node<Key, Value>* root)
+{
+	return cloneNodes(root);
+}
+
+/**
+* Copies every node below and including root into nodes drawn from this
+* tree's allocator. Each node is copy constructed, so any extra fields such 
+* as heights come along, and then relinked to its copied neighbours. The
+* walk follows parent pointers, so it does not recurse.
+*/
+template<typename Key, typename Value>
+template<typename NodeType>
+NodeType* BinarySearchTree<Key, Value>::cloneNodes(const NodeType* root)
+{
+	if(root == nullptr) 
+	{
+		return nullptr;
+	}
 
-			} else {
+	NodeType* copy = createNode<NodeType>(*root);
+	copy->setParent(nullptr);
+	copy->setLeft(nullptr);
+	copy->setRight(nullptr);
 
-				parent->setRight(to_remove->getRight());
-				parent->getRight()->setParent(parent);	
-			}
+	const NodeType* src = root;
+	NodeType* dst = copy;
+	while(true) 
+	{
+		const NodeType* next = nullptr;
+		if(src->getLeft() && !dst->getLeft()) 
+		{
+			next = src->getLeft();
+		} 
+		else if(src->getRight() && !dst->getRight()) 
+		{
+			next = src->getRight();
 		}
 
-		delete to_remove;
+		if(next) 
+		{
+			NodeType* child = createNode<NodeType>(*next);
+			child->setParent(dst);
+			child->setLeft(nullptr);
+			child->setRight(nullptr);
+			if(next == src->getLeft()) 
+			{
+				dst->setLeft(child);
 
-	} else {
+			} else {
 
-		Node<Key,Value>* predecessor = getPredecessor(to_remove);
-		swapPred(to_remove, predecessor);
-		removeHelper(key, to_remove);
+				dst->setRight(child);
+			}
+			src = next;
+			dst = child;
+		} 
+		else if(src == root) 
+		{
+			break;
+		} 
+		else 
+		{
+			src = src->getParent();
+			dst = dst->getParent();
+		}
 	}
-
+	return copy;
 }
 
-/** 
- * Swaps a node with it's predecessor.
- */
+/**
+* Destroys a node through its static type and hands its memory back to
+* the tree's allocator.
+*/
 template<typename Key, typename Value>
-void BinarySearchTree<Key,Value>::swapPred(Node<Key,Value>* remove , Node<Key,Value>* pred)
+template<typename NodeType>
+void BinarySearchTree<Key, Value>::destroyNode(NodeType* node)
 {
+	node->~NodeType();
+	mAllocator->deallocate(node);
+}
 
-	bool root = false;
-	bool remove_right = false;
-	bool remove_left = false;
+/**
+* Replaces the contents of the tree with the items in [first, last), which must
+* be sorted by key. The tree is assembled directly into a perfectly balanced 
+* shape in linear time. Runs of equal keys keep the last value given, just as 
+* repeated inserts would.
+*/
+template<typename Key, typename Value>
+template<typename InputIterator>
+void BinarySearchTree<Key, Value>::buildFromSorted(InputIterator first, InputIterator last)
+{
+	std::vector<std::pair<Key, Value> > items(first, last);
+	keepLastOfEachKey(items);
+	clear();
+	buildBalanced(items);
+	resetBounds(items.size());
+}
 
-	Node<Key,Value>* new_pred_parent = remove->getParent();
-    Node<Key,Value>* new_pred_left = remove->getLeft();
-    Node<Key,Value>* new_pred_right = remove->getRight();
-    Node<Key,Value>* new_remove_parent = pred->getParent();
-    Node<Key,Value>* new_remove_left = pred->getLeft();
-    Node<Key,Value>* new_remove_right = nullptr;
+/**
+* Replaces the contents of the tree with the items in [first, last) in any order.
+* The items are sorted first, so this runs in O(n log n); when a key repeats,
+* the value that came last in the input wins, just as repeated inserts would.
+*/
+template<typename Key, typename Value>
+template<typename InputIterator>
+void BinarySearchTree<Key, Value>::build(InputIterator first, InputIterator last)
+{
+	std::vector<std::pair<Key, Value> > items(first, last);
+	std::stable_sort(items.begin(), items.end(), 
+		[](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return a.first < b.first; });
+	keepLastOfEachKey(items);
+	clear();
+	buildBalanced(items);
+	resetBounds(items.size());
+}
 
-    if(pred->getParent() == remove) {
-		new_remove_parent = pred;
-		new_pred_left = remove; 
-	}
-	
-	if(remove->getParent()) {
-		if(remove->getParent()->getRight() == remove) 
+/**
+* Collapses each run of equal keys in a sorted vector down to its last item.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::keepLastOfEachKey(std::vector<std::pair<Key, Value> >& items)
+{
+	std::size_t kept = 0;
+	for(std::size_t i = 0; i < items.size(); ++i) 
+	{
+		if(kept > 0 && !(items[kept - 1].first < items[i].first)) 
 		{
-			remove_right = true;
+			items[kept - 1].second = std::move(items[i].second);
 
 		} else {
 
-			remove_left = true;
+			if(kept != i) 
+			{
+				items[kept] = std::move(items[i]);
+			}
+			++kept;
 		}
-	} else {
-
-		root = true;
 	}
+	items.erase(items.begin() + kept, items.end());
+}
 
-	remove->setParent(new_remove_parent);
-	remove->setLeft(new_remove_left);
-	remove->setRight(new_remove_right);
-
-	if(pred->getParent()->getRight() == pred) {
-		
-		remove->getParent()->setRight(remove);
-		
-	} else if(pred->getParent()->getLeft() == pred) {
-
-		remove->getParent()->setRight(remove);
-	}
+/**
+* Builds the nodes of an empty tree from sorted, distinct items, moving the 
+* items into the nodes. Trees with
+* their own kind of node override this to build that node type instead.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::buildBalanced(std::vector<std::pair<Key, Value> >& items)
+{
+	int height = 0;
+	mRoot = buildRange<Node<Key, Value> >(items, 0, items.size(), nullptr, height);
+}
 
-	if(remove->getLeft()) 
+/**
+* Creates a perfectly balanced subtree holding items[first, last) by making
+* the middle item the root and building each half below it. The recursion 
+* is only as deep as the resulting subtree. Reports the height of the subtree
+* and stores it, along with the subtree size, in every node that keeps them.
+*/
+template<typename Key, typename Value>
+template<typename NodeType>
+NodeType* BinarySearchTree<Key, Value>::buildRange(std::vector<std::pair<Key, Value> >& items,
+	std::size_t first, std::size_t last, NodeType* parent, int& height)
+{
+	if(first == last) 
 	{
-		remove->getLeft()->setParent(remove);
+		height = 0;
+		return nullptr;
 	}
 
-	pred->setParent(new_pred_parent);
-	pred->setLeft(new_pred_left);
-	pred->setRight(new_pred_right);
-	pred->getLeft()->setParent(pred);
-	pred->getRight()->setParent(pred);
+	std::size_t middle = first + (last - first) / 2;
+	NodeType* root = createNode<NodeType>(std::move(items[middle]), parent);
 
-	if(remove_right) {
-		pred->getParent()->setRight(pred);
-	} else if(remove_left) {
-		pred->getParent()->setLeft(pred);
-	}
-	
-	if(root) {
-		mRoot = pred;
-	} 
-} 
+	int left = 0;
+	int right = 0;
+	root->setLeft(buildRange(items, first, middle, root, left));
+	root->setRight(buildRange(items, middle + 1, last, root, right));
+
+	height = 1 + std::max(left, right);
+	storeHeight(root, height);
+	updateCount(root);
+	return root;
+}
 
 /**
-* A method to remove all contents of the tree and reset the values in the tree
-* for use again.
+* A helper function to find the smallest node in the tree, which is cached.
 */
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
-{	
-	helpClear(mRoot);
-	mRoot = nullptr;
+Node<Key, Value>* BinarySearchTree<Key, Value>::getSmallestNode() const
+{
+	return mFirst;
 }
 
+/**
+* A helper function to find the largest node in the tree, which is cached.
+*/
 template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::helpClear(Node<Key,Value>* root)
+Node<Key, Value>* BinarySearchTree<Key, Value>::getLargestNode() const
 {
-	if(root == nullptr) 
+	return mLast;
+}
+
+/**
+* Returns the node after the given one in an in-order traversal,
+* or NULL if it is the largest.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::successor(const Node<Key, Value>* node)
+{
+	if(node->getRight() != NULL)
 	{
-		return;
+		Node<Key, Value>* curr = node->getRight();
+		while(curr->getLeft() != NULL)
+		{
+			curr = curr->getLeft();
+		}
+		return curr;
 	}
-	helpClear(root->getRight());
-	helpClear(root->getLeft());
 
-	delete root;
+	Node<Key, Value>* parent = node->getParent();
+	while(parent != NULL && node == parent->getRight())
+	{
+		node = parent;
+		parent = parent->getParent();
+	}
+	return parent;
 }
 
 /**
-* A helper function to find the smallest node in the tree.
+* Returns the node before the given one in an in-order traversal,
+* or NULL if it is the smallest.
 */
 template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::getSmallestNode() const
+Node<Key, Value>* BinarySearchTree<Key, Value>::predecessor(const Node<Key, Value>* node)
 {
-	if(mRoot == nullptr) 
+	if(node->getLeft() != NULL)
 	{
-		return nullptr;
-
-	} else {
-
-		Node<Key, Value>* temp = mRoot;
-		while(temp->getLeft() != NULL) {
-			temp = temp->getLeft();
+		Node<Key, Value>* curr = node->getLeft();
+		while(curr->getRight() != NULL)
+		{
+			curr = curr->getRight();
 		}
-		return temp;
+		return curr;
+	}
+
+	Node<Key, Value>* parent = node->getParent();
+	while(parent != NULL && node == parent->getLeft())
+	{
+		node = parent;
+		parent = parent->getParent();
 	}
+	return parent;
 }
 
 /** 
@@ -720,88 +2006,230 @@ Node<Key, Value>* BinarySearchTree<Key, Value>::getPredecessor(Node<Key,Value>*
 
 /** 
  * Find function that returns a pointer to 
- * a node with the specified key. 
+ * a node with the specified key, or NULL if
+ * no item with that key exists.
  */
 template<typename Key, typename Value>
 Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
 {
-	if(mRoot == nullptr || mRoot->getKey() == key) {
-		return mRoot;
+	Node<Key, Value>* curr = mRoot;
+	while(curr != nullptr) 
+	{
+		if(key < curr->getKey()) 
+		{
+			curr = curr->getLeft();
+		} 
+		else if(curr->getKey() < key) 
+		{
+			curr = curr->getRight();
+		} 
+		else 
+		{
+			return curr;
+		}
 	}
-	return internalFindHelper(key, mRoot);
+	return nullptr;
 }
 
 /**
-* Helper function to find a node with given key, k and
-* return a pointer to it or NULL if no item with that key
-* exists.
+* Finds the leftmost node whose key is at least the given key when
+* inclusive, or strictly greater than it otherwise. Returns NULL if
+* every key in the tree falls below the bound.
 */
 template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFindHelper(const Key& key, Node<Key,Value>* root) const
+Node<Key, Value>* BinarySearchTree<Key, Value>::internalBound(const Key& key, bool inclusive) const
 {
-	if(root == nullptr || root->getKey() == key) {
-		return root;
-	}
-	
-	if(key < root->getKey()) 
+	Node<Key, Value>* bound = nullptr;
+	Node<Key, Value>* curr = mRoot;
+	while(curr != nullptr) 
 	{
-		return internalFindHelper(key, root->getLeft());
-	}  
-	else 
-	{
-		return internalFindHelper(key, root->getRight());	
+		if(inclusive ? !(curr->getKey() < key) : key < curr->getKey()) 
+		{
+			bound = curr;
+			curr = curr->getLeft();
+
+		} else {
+
+			curr = curr->getRight();
+		}
 	}
+	return bound;
 }
 
 /**
-* Returns the height of the tree rooted
-* at a specific node.
-*/
+ * Return true iff the BST is an AVL Tree.
+ */
 template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::checkHeight(Node<Key,Value>* root) const
+bool BinarySearchTree<Key, Value>::isBalanced() const
 {
-	if(root == nullptr) return 0;
-
-	int left = checkHeight(root->getLeft());
-	int right = checkHeight(root->getRight());
-
-	if(left > right) 
-	{
-		return 1+left;
-
-	} else {
-
-		return 1+right;
-
-	}
+	return validate().balanced;
 }
 
+/**
+ * Checks balance, key order and parent links and measures
+ * the height and size of the tree in a single linear pass.
+ */
+template<typename Key, typename Value>
+TreeStats BinarySearchTree<Key, Value>::validate() const
+{
+	return validateNodes(mRoot);
+}
 
 /**
- * Return true iff the BST is an AVL Tree.
+ * Hashes the items together with the shape of the tree, so two trees
+ * hash alike only if they hold the same items laid out the same way, as
+ * replicas rebuilt with rotateBST::transform do. The walk is a pre-order
+ * one through the parent pointers that folds in each node's key and
+ * value and which of its children are present, which pins down the shape.
  */
 template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+std::size_t BinarySearchTree<Key, Value>::structuralHash() const
 {
-	return returnBalanced(mRoot);
+	std::hash<Key> hashKey;
+	std::hash<Value> hashValue;
+	std::size_t hash = 0;
+
+	const Node<Key, Value>* prev = nullptr;
+	const Node<Key, Value>* curr = mRoot;
+	while(curr) 
+	{
+		const Node<Key, Value>* next;
+		if(prev == curr->getParent()) 
+		{
+			std::size_t children = (curr->getLeft() ? 1 : 0) | (curr->getRight() ? 2 : 0);
+			std::size_t parts[3] = { hashKey(curr->getKey()), hashValue(curr->getValue()), children };
+			for(std::size_t i = 0; i < 3; ++i) 
+			{
+				hash ^= parts[i] + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+			}
+			next = curr->getLeft() ? curr->getLeft() : curr->getRight() ? curr->getRight() : curr->getParent();
+		} 
+		else if(prev == curr->getLeft() && curr->getRight()) 
+		{
+			next = curr->getRight();
+		} 
+		else 
+		{
+			next = curr->getParent();
+		}
+		prev = curr;
+		curr = next;
+	}
+	return hash;
 }
 
+/**
+ * Walks the tree in post-order through the parent pointers, so
+ * the call stack stays flat however deep the tree is. Each finished
+ * subtree leaves its height and extreme nodes on a side stack for its
+ * parent to combine, making every node's check constant time. A broken
+ * parent link ends the walk early since it can no longer be trusted.
+ * The cached bounds and size are checked against what the walk found.
+ */
 template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::returnBalanced(Node<Key,Value>* root) const
+template<typename NodeType>
+TreeStats BinarySearchTree<Key, Value>::validateNodes(NodeType* root) const
 {
-	if(root == nullptr) {
-		return true;
+	struct Subtree 
+	{
+		int height;
+		std::size_t size;
+		NodeType* smallest;
+		NodeType* largest;
+	};
+
+	TreeStats stats = { true, true, true, true, true, true, 0, 0 };
+	if(root == nullptr) 
+	{
+		stats.boundsValid = mFirst == nullptr && mLast == nullptr && (mSize == 0 || mSize == kUnknownSize);
+		return stats;
+	}
+	if(root->getParent() != nullptr) 
+	{
+		stats.linked = false;
+		return stats;
 	}
 
-	int left = checkHeight(root->getLeft());
-	int right = checkHeight(root->getRight());
+	std::vector<Subtree> done;
+	NodeType* prev = nullptr;
+	NodeType* curr = root;
 
-	if(abs(left-right) <= 1 && returnBalanced(root->getRight()) 
-		&& returnBalanced(root->getLeft())) 
+	while(curr != nullptr) 
 	{
-		return true;
+		NodeType* next = nullptr;
+		if(prev == curr->getParent()) 
+		{
+			next = curr->getLeft() ? curr->getLeft() : curr->getRight();
+		} 
+		else if(prev == curr->getLeft()) 
+		{
+			next = curr->getRight();
+		}
+
+		if(next != nullptr) 
+		{
+			if(next->getParent() != curr) 
+			{
+				stats.linked = false;
+				return stats;
+			}
+			prev = curr;
+			curr = next;
+			continue;
+		}
+
+		Subtree node = { 1, 1, curr, curr };
+		int right = 0;
+		int left = 0;
+		if(curr->getRight()) 
+		{
+			Subtree sub = done.back();
+			done.pop_back();
+			right = sub.height;
+			node.size += sub.size;
+			node.largest = sub.largest;
+			if(!(curr->getKey() < sub.smallest->getKey())) 
+			{
+				stats.ordered = false;
+			}
+		}
+		if(curr->getLeft()) 
+		{
+			Subtree sub = done.back();
+			done.pop_back();
+			left = sub.height;
+			node.size += sub.size;
+			node.smallest = sub.smallest;
+			if(!(sub.largest->getKey() < curr->getKey())) 
+			{
+				stats.ordered = false;
+			}
+		}
+
+		node.height = 1 + std::max(left, right);
+		if(abs(left - right) > 1) 
+		{
+			stats.balanced = false;
+		}
+		if(!heightMatches(curr, node.height)) 
+		{
+			stats.heightsValid = false;
+		}
+		if(!countMatches(curr, node.size)) 
+		{
+			stats.countsValid = false;
+		}
+		++stats.size;
+		done.push_back(node);
+
+		prev = curr;
+		curr = curr->getParent();
 	}
-	return false;
+
+	stats.height = done.back().height;
+	stats.boundsValid = done.back().smallest == mFirst && done.back().largest == mLast
+		&& (mSize == stats.size || mSize == kUnknownSize);
+	return stats;
 }
 
 /**
@@ -822,4 +2250,62 @@ bool BinarySearchTree<Key, Value>::returnBalanced(Node<Key,Value>* root) const
 	---------------------------------------------------
 */
 
+/**
+* Two trees are equal if they hold the same items in key order, whatever
+* their shape. Trees of different sizes are told apart at once, and
+* otherwise the walk stops at the first item that differs.
+*/
+template<typename Key, typename Value>
+bool operator==(const BinarySearchTree<Key, Value>& lhs, const BinarySearchTree<Key, Value>& rhs)
+{
+	if(lhs.size() != rhs.size()) 
+	{
+		return false;
+	}
+	typename BinarySearchTree<Key, Value>::const_iterator it = lhs.begin();
+	typename BinarySearchTree<Key, Value>::const_iterator jt = rhs.begin();
+	for(; it != lhs.end() && jt != rhs.end(); ++it, ++jt) 
+	{
+		if(!(*it == *jt)) 
+		{
+			return false;
+		}
+	}
+	return it == lhs.end() && jt == rhs.end();
+}
+
+template<typename Key, typename Value>
+bool operator!=(const BinarySearchTree<Key, Value>& lhs, const BinarySearchTree<Key, Value>& rhs)
+{
+	return !(lhs == rhs);
+}
+
+/**
+* Orders trees lexicographically by their items in key order, as the
+* standard containers are ordered.
+*/
+template<typename Key, typename Value>
+bool operator<(const BinarySearchTree<Key, Value>& lhs, const BinarySearchTree<Key, Value>& rhs)
+{
+	return std::lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
+}
+
+template<typename Key, typename Value>
+bool operator>(const BinarySearchTree<Key, Value>& lhs, const BinarySearchTree<Key, Value>& rhs)
+{
+	return rhs < lhs;
+}
+
+template<typename Key, typename Value>
+bool operator<=(const BinarySearchTree<Key, Value>& lhs, const BinarySearchTree<Key, Value>& rhs)
+{
+	return !(rhs < lhs);
+}
+
+template<typename Key, typename Value>
+bool operator>=(const BinarySearchTree<Key, Value>& lhs, const BinarySearchTree<Key, Value>& rhs)
+{
+	return !(lhs < rhs);
+}
+
 #endif
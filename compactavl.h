@@ -0,0 +1,960 @@
+#ifndef COMPACTAVL_H
+#define COMPACTAVL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+* An AVL tree laid out to spend as few bytes per item as it can, for trees
+* of small keys and values where the links cost more than the items.
+*
+* Nodes live in slabs owned by the tree and link to each other by 32 bit
+* index instead of by pointer, with index 0 meaning none. Instead of its
+* height each node keeps its balance factor, the height of its right
+* subtree minus that of its left, in one byte. Next to the item that is
+* 13 bytes per node, padded to the item's alignment: 24 bytes for an
+* <int, int> tree and 32 for <uint64_t, uint64_t>, where an AVLNode takes
+* 40 and 48 before the pool's own rounding.
+*
+* The tree holds at most 2^32 - 2 items. Removing an item with two
+* children moves its successor's item into its node, so iterators only
+* stay valid until the tree is next modified. Values are changed through
+* insert(), which overwrites the value of a key that is present.
+*/
+template <typename Key, typename Value>
+class CompactAVLTree
+{
+	public:
+		CompactAVLTree();
+		CompactAVLTree(const CompactAVLTree<Key, Value>& other);
+		CompactAVLTree(CompactAVLTree<Key, Value>&& other);
+		~CompactAVLTree();
+		CompactAVLTree<Key, Value>& operator=(const CompactAVLTree<Key, Value>& other);
+		CompactAVLTree<Key, Value>& operator=(CompactAVLTree<Key, Value>&& other);
+
+		void insert(const std::pair<Key, Value>& keyValuePair);
+		void insert(std::pair<Key, Value>&& keyValuePair);
+		void remove(const Key& key);
+		void clear();
+		std::size_t size() const;
+		bool empty() const;
+		std::size_t memoryUsage() const;
+		TreeStats validate() const;
+
+	protected:
+		/**
+		* A node of the tree. It has no constructor of its own, since the
+		* item is built in place in slab memory and the links set after.
+		*/
+		struct CompactNode
+		{
+			std::pair<Key, Value> mItem;
+			std::uint32_t mLeft;
+			std::uint32_t mRight;
+			std::uint32_t mParent;
+			std::int8_t mBalance;
+		};
+
+	public:
+		/**
+		* A read-only bidirectional iterator over the items in key order.
+		*/
+		class const_iterator
+		{
+			public:
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef std::pair<Key, Value> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef const std::pair<Key, Value>* pointer;
+				typedef const std::pair<Key, Value>& reference;
+
+				const_iterator(std::uint32_t index, const CompactAVLTree<Key, Value>* tree);
+				const_iterator();
+
+				const std::pair<Key, Value>& operator*() const;
+				const std::pair<Key, Value>* operator->() const;
+
+				bool operator==(const const_iterator& rhs) const;
+				bool operator!=(const const_iterator& rhs) const;
+
+				const_iterator& operator++();
+				const_iterator operator++(int);
+				const_iterator& operator--();
+				const_iterator operator--(int);
+
+			protected:
+				std::uint32_t mIndex;
+				const CompactAVLTree<Key, Value>* mTree;
+
+				friend class CompactAVLTree<Key, Value>;
+		};
+
+		typedef const_iterator iterator;
+
+	public:
+		const_iterator begin() const;
+		const_iterator end() const;
+		const_iterator find(const Key& key) const;
+		const_iterator lower_bound(const Key& key) const;
+
+	protected:
+		// Slabs hold 2^kSlabShift nodes each, so that locating a node is a
+		// shift and a mask, and growing never moves the nodes already there.
+		static const unsigned kSlabShift = 12;
+		static const std::uint32_t kSlabNodes = 1u << kSlabShift;
+		static const std::uint32_t kNone = 0;
+
+		CompactNode& at(std::uint32_t index) const;
+		std::uint32_t first(std::uint32_t index) const;
+		std::uint32_t last(std::uint32_t index) const;
+		std::uint32_t successor(std::uint32_t index) const;
+		std::uint32_t predecessor(std::uint32_t index) const;
+		template<typename Item>
+		void insertItem(Item&& item);
+		template<typename Item>
+		std::uint32_t createNode(Item&& item, std::uint32_t parent);
+		void destroyNode(std::uint32_t index);
+		void replaceChild(std::uint32_t parent, std::uint32_t from, std::uint32_t to);
+		void rotateLeft(std::uint32_t index);
+		void rotateRight(std::uint32_t index);
+		std::uint32_t rebalance(std::uint32_t index);
+		std::uint32_t cloneNodes(const CompactAVLTree<Key, Value>& other, std::uint32_t index, std::uint32_t parent);
+		int validateNode(std::uint32_t index, const Key* low, const Key* high, TreeStats& stats) const;
+
+	protected:
+		std::vector<CompactNode*> mSlabs;
+		std::uint32_t mRoot;
+		std::uint32_t mNextIndex;	// never used yet; slots from here to the end of the last slab are free
+		std::uint32_t mFreeList;	// freed slots, chained through mLeft
+		std::size_t mSize;
+};
+
+template <typename Key, typename Value>
+const unsigned CompactAVLTree<Key, Value>::kSlabShift;
+template <typename Key, typename Value>
+const std::uint32_t CompactAVLTree<Key, Value>::kSlabNodes;
+template <typename Key, typename Value>
+const std::uint32_t CompactAVLTree<Key, Value>::kNone;
+
+/*
+	---------------------------------------------------------------------
+	Begin implementations for the CompactAVLTree::const_iterator class.
+	---------------------------------------------------------------------
+*/
+
+/**
+* Constructor for an iterator at the node with the given index, or at the
+* end if it is 0. The end iterator needs the tree to step back from.
+*/
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::const_iterator::const_iterator(std::uint32_t index, const CompactAVLTree<Key, Value>* tree)
+	: mIndex(index)
+	, mTree(tree)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to the end of no tree.
+*/
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::const_iterator::const_iterator()
+	: mIndex(kNone)
+	, mTree(nullptr)
+{
+
+}
+
+/**
+* Provides read-only access to the item.
+*/
+template<typename Key, typename Value>
+const std::pair<Key, Value>& CompactAVLTree<Key, Value>::const_iterator::operator*() const
+{
+	return mTree->at(mIndex).mItem;
+}
+
+/**
+* Provides read-only member access to the item.
+*/
+template<typename Key, typename Value>
+const std::pair<Key, Value>* CompactAVLTree<Key, Value>::const_iterator::operator->() const
+{
+	return &mTree->at(mIndex).mItem;
+}
+
+/**
+* Checks if 'this' iterator is at the same item as 'rhs'
+*/
+template<typename Key, typename Value>
+bool CompactAVLTree<Key, Value>::const_iterator::operator==(const const_iterator& rhs) const
+{
+	return mIndex == rhs.mIndex;
+}
+
+/**
+* Checks if 'this' iterator is at a different item than 'rhs'
+*/
+template<typename Key, typename Value>
+bool CompactAVLTree<Key, Value>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+	return mIndex != rhs.mIndex;
+}
+
+/**
+* Advances the iterator to the next item in key order.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::const_iterator& CompactAVLTree<Key, Value>::const_iterator::operator++()
+{
+	mIndex = mTree->successor(mIndex);
+	return *this;
+}
+
+/**
+* Advances the iterator and returns its previous position.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::const_iterator CompactAVLTree<Key, Value>::const_iterator::operator++(int)
+{
+	const_iterator old(*this);
+	++(*this);
+	return old;
+}
+
+/**
+* Moves the iterator back to the previous item. Decrementing the end
+* iterator lands on the largest item.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::const_iterator& CompactAVLTree<Key, Value>::const_iterator::operator--()
+{
+	mIndex = mIndex == kNone ? mTree->last(mTree->mRoot) : mTree->predecessor(mIndex);
+	return *this;
+}
+
+/**
+* Moves the iterator back and returns its previous position.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::const_iterator CompactAVLTree<Key, Value>::const_iterator::operator--(int)
+{
+	const_iterator old(*this);
+	--(*this);
+	return old;
+}
+
+/*
+	-------------------------------------------------------------------
+	End implementations for the CompactAVLTree::const_iterator class.
+	-------------------------------------------------------------------
+*/
+
+/*
+	---------------------------------------------------
+	Begin implementations for the CompactAVLTree class.
+	---------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree, which owns no slabs yet.
+*/
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::CompactAVLTree()
+	: mRoot(kNone)
+	, mNextIndex(1)
+	, mFreeList(kNone)
+	, mSize(0)
+{
+
+}
+
+/**
+* Copy constructor. The copy has the same shape as the original, with its
+* nodes packed into slabs of its own in pre-order.
+*/
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::CompactAVLTree(const CompactAVLTree<Key, Value>& other)
+	: CompactAVLTree()
+{
+	mRoot = cloneNodes(other, other.mRoot, kNone);
+	mSize = other.mSize;
+}
+
+/**
+* Move constructor, which takes over the other tree's slabs and leaves it empty.
+*/
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::CompactAVLTree(CompactAVLTree<Key, Value>&& other)
+	: mSlabs(std::move(other.mSlabs))
+	, mRoot(other.mRoot)
+	, mNextIndex(other.mNextIndex)
+	, mFreeList(other.mFreeList)
+	, mSize(other.mSize)
+{
+	other.mSlabs.clear();
+	other.mRoot = kNone;
+	other.mNextIndex = 1;
+	other.mFreeList = kNone;
+	other.mSize = 0;
+}
+
+/**
+* Destructor, which destroys the items and frees the slabs.
+*/
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>::~CompactAVLTree()
+{
+	clear();
+}
+
+/**
+* Copy assignment, which replaces the contents with a copy of the other tree.
+*/
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>& CompactAVLTree<Key, Value>::operator=(const CompactAVLTree<Key, Value>& other)
+{
+	if(this != &other)
+	{
+		clear();
+		mRoot = cloneNodes(other, other.mRoot, kNone);
+		mSize = other.mSize;
+	}
+	return *this;
+}
+
+/**
+* Move assignment, which frees the current contents and swaps the now
+* empty tree with the other one.
+*/
+template<typename Key, typename Value>
+CompactAVLTree<Key, Value>& CompactAVLTree<Key, Value>::operator=(CompactAVLTree<Key, Value>&& other)
+{
+	if(this != &other)
+	{
+		clear();
+		std::swap(mSlabs, other.mSlabs);
+		std::swap(mRoot, other.mRoot);
+		std::swap(mNextIndex, other.mNextIndex);
+		std::swap(mFreeList, other.mFreeList);
+		std::swap(mSize, other.mSize);
+	}
+	return *this;
+}
+
+/**
+* Inserts an item, or overwrites the value if the key is present.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+	insertItem(keyValuePair);
+}
+
+/**
+* Inserts an item by moving it into the tree, or moves just the value over
+* the existing one if the key is present.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+	insertItem(std::move(keyValuePair));
+}
+
+/**
+* Walks down to the key and either updates the value there or hangs a new
+* leaf. The balance factors are then fixed from the leaf's parent upwards:
+* a parent that ends up even stops the walk, one that tips by one passes
+* the growth on, and one that tips by two is rotated back into balance,
+* which leaves its subtree as high as before the insert.
+*/
+template<typename Key, typename Value>
+template<typename Item>
+void CompactAVLTree<Key, Value>::insertItem(Item&& item)
+{
+	std::uint32_t parent = kNone;
+	std::uint32_t curr = mRoot;
+	bool leftSide = false;
+	while(curr != kNone)
+	{
+		CompactNode& node = at(curr);
+		if(item.first < node.mItem.first)
+		{
+			parent = curr;
+			curr = node.mLeft;
+			leftSide = true;
+		}
+		else if(node.mItem.first < item.first)
+		{
+			parent = curr;
+			curr = node.mRight;
+			leftSide = false;
+		}
+		else
+		{
+			node.mItem.second = std::forward<Item>(item).second;
+			return;
+		}
+	}
+
+	std::uint32_t leaf = createNode(std::forward<Item>(item), parent);
+	++mSize;
+	if(parent == kNone)
+	{
+		mRoot = leaf;
+		return;
+	}
+	if(leftSide)
+	{
+		at(parent).mLeft = leaf;
+
+	} else {
+
+		at(parent).mRight = leaf;
+	}
+
+	std::uint32_t child = leaf;
+	while(parent != kNone)
+	{
+		CompactNode& node = at(parent);
+		node.mBalance += node.mLeft == child ? -1 : 1;
+		if(node.mBalance == 0)
+		{
+			return;
+		}
+		if(node.mBalance == 2 || node.mBalance == -2)
+		{
+			rebalance(parent);
+			return;
+		}
+		child = parent;
+		parent = node.mParent;
+	}
+}
+
+/**
+* Removes the item with the given key, if present. A node with two
+* children takes over its successor's item, and the successor's node,
+* which has at most one child, is unlinked instead. The balance factors
+* are then fixed upwards from its parent: a parent that ends up tipped by
+* one stops the walk, as its height did not change, and one tipped by two
+* is rotated, which only stops the walk if the rotation kept the height.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::remove(const Key& key)
+{
+	std::uint32_t target = find(key).mIndex;
+	if(target == kNone)
+	{
+		return;
+	}
+
+	if(at(target).mLeft != kNone && at(target).mRight != kNone)
+	{
+		std::uint32_t next = first(at(target).mRight);
+		std::swap(at(target).mItem, at(next).mItem);
+		target = next;
+	}
+
+	CompactNode& node = at(target);
+	std::uint32_t child = node.mLeft != kNone ? node.mLeft : node.mRight;
+	std::uint32_t parent = node.mParent;
+	bool leftSide = parent != kNone && at(parent).mLeft == target;
+	if(child != kNone)
+	{
+		at(child).mParent = parent;
+	}
+	replaceChild(parent, target, child);
+	destroyNode(target);
+	--mSize;
+
+	while(parent != kNone)
+	{
+		CompactNode* curr = &at(parent);
+		curr->mBalance += leftSide ? 1 : -1;
+		if(curr->mBalance == 1 || curr->mBalance == -1)
+		{
+			return;
+		}
+		if(curr->mBalance != 0)
+		{
+			parent = rebalance(parent);
+			curr = &at(parent);
+			if(curr->mBalance != 0)
+			{
+				return;
+			}
+		}
+		std::uint32_t up = curr->mParent;
+		leftSide = up != kNone && at(up).mLeft == parent;
+		parent = up;
+	}
+}
+
+/**
+* Destroys every item and frees the slabs. Items that need no destructor
+* are not visited at all.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::clear()
+{
+	if(!std::is_trivially_destructible<std::pair<Key, Value> >::value)
+	{
+		for(std::uint32_t curr = first(mRoot); curr != kNone; curr = successor(curr))
+		{
+			at(curr).mItem.~pair();
+		}
+	}
+	for(std::size_t i = 0; i < mSlabs.size(); ++i)
+	{
+		::operator delete(mSlabs[i]);
+	}
+	mSlabs.clear();
+	mRoot = kNone;
+	mNextIndex = 1;
+	mFreeList = kNone;
+	mSize = 0;
+}
+
+/**
+* Returns the number of items in the tree.
+*/
+template<typename Key, typename Value>
+std::size_t CompactAVLTree<Key, Value>::size() const
+{
+	return mSize;
+}
+
+/**
+* Returns true if the tree holds no items.
+*/
+template<typename Key, typename Value>
+bool CompactAVLTree<Key, Value>::empty() const
+{
+	return mSize == 0;
+}
+
+/**
+* Returns the bytes the tree holds on the heap for its slabs and the
+* table of them, free slots included.
+*/
+template<typename Key, typename Value>
+std::size_t CompactAVLTree<Key, Value>::memoryUsage() const
+{
+	return mSlabs.size() * kSlabNodes * sizeof(CompactNode) + mSlabs.capacity() * sizeof(CompactNode*);
+}
+
+/**
+* Checks the order, links and balance factors of the whole tree in one
+* recursive pass, which is only as deep as the tree is high.
+*/
+template<typename Key, typename Value>
+TreeStats CompactAVLTree<Key, Value>::validate() const
+{
+	TreeStats stats = {true, true, true, true, true, true, 0, 0};
+	if(mRoot != kNone && at(mRoot).mParent != kNone)
+	{
+		stats.linked = false;
+	}
+	stats.height = validateNode(mRoot, nullptr, nullptr, stats);
+	stats.countsValid = stats.size == mSize;
+	return stats;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::const_iterator CompactAVLTree<Key, Value>::begin() const
+{
+	return const_iterator(first(mRoot), this);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::const_iterator CompactAVLTree<Key, Value>::end() const
+{
+	return const_iterator(kNone, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::const_iterator CompactAVLTree<Key, Value>::find(const Key& key) const
+{
+	std::uint32_t curr = mRoot;
+	while(curr != kNone)
+	{
+		const CompactNode& node = at(curr);
+		if(key < node.mItem.first)
+		{
+			curr = node.mLeft;
+		}
+		else if(node.mItem.first < key)
+		{
+			curr = node.mRight;
+		}
+		else
+		{
+			break;
+		}
+	}
+	return const_iterator(curr, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than the
+* given key, or the end iterator if there is none.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::const_iterator CompactAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+	std::uint32_t bound = kNone;
+	std::uint32_t curr = mRoot;
+	while(curr != kNone)
+	{
+		const CompactNode& node = at(curr);
+		if(node.mItem.first < key)
+		{
+			curr = node.mRight;
+
+		} else {
+
+			bound = curr;
+			curr = node.mLeft;
+		}
+	}
+	return const_iterator(bound, this);
+}
+
+/**
+* Returns the node with the given index, which must not be 0.
+*/
+template<typename Key, typename Value>
+typename CompactAVLTree<Key, Value>::CompactNode& CompactAVLTree<Key, Value>::at(std::uint32_t index) const
+{
+	return mSlabs[index >> kSlabShift][index & (kSlabNodes - 1)];
+}
+
+/**
+* Returns the leftmost node below and including the given one, or 0 for
+* an empty subtree.
+*/
+template<typename Key, typename Value>
+std::uint32_t CompactAVLTree<Key, Value>::first(std::uint32_t index) const
+{
+	if(index != kNone)
+	{
+		while(at(index).mLeft != kNone)
+		{
+			index = at(index).mLeft;
+		}
+	}
+	return index;
+}
+
+/**
+* Returns the rightmost node below and including the given one, or 0 for
+* an empty subtree.
+*/
+template<typename Key, typename Value>
+std::uint32_t CompactAVLTree<Key, Value>::last(std::uint32_t index) const
+{
+	if(index != kNone)
+	{
+		while(at(index).mRight != kNone)
+		{
+			index = at(index).mRight;
+		}
+	}
+	return index;
+}
+
+/**
+* Returns the node after the given one in key order, or 0 if it is the largest.
+*/
+template<typename Key, typename Value>
+std::uint32_t CompactAVLTree<Key, Value>::successor(std::uint32_t index) const
+{
+	if(at(index).mRight != kNone)
+	{
+		return first(at(index).mRight);
+	}
+	std::uint32_t parent = at(index).mParent;
+	while(parent != kNone && at(parent).mRight == index)
+	{
+		index = parent;
+		parent = at(parent).mParent;
+	}
+	return parent;
+}
+
+/**
+* Returns the node before the given one in key order, or 0 if it is the smallest.
+*/
+template<typename Key, typename Value>
+std::uint32_t CompactAVLTree<Key, Value>::predecessor(std::uint32_t index) const
+{
+	if(at(index).mLeft != kNone)
+	{
+		return last(at(index).mLeft);
+	}
+	std::uint32_t parent = at(index).mParent;
+	while(parent != kNone && at(parent).mLeft == index)
+	{
+		index = parent;
+		parent = at(parent).mParent;
+	}
+	return parent;
+}
+
+/**
+* Builds a leaf for the item in a free slot, reusing freed slots first and
+* adding a slab when every slot is in use. Index 0 is never handed out.
+*/
+template<typename Key, typename Value>
+template<typename Item>
+std::uint32_t CompactAVLTree<Key, Value>::createNode(Item&& item, std::uint32_t parent)
+{
+	std::uint32_t index = mFreeList;
+	if(index != kNone)
+	{
+		mFreeList = at(index).mLeft;
+
+	} else {
+
+		if(mNextIndex == 0)
+		{
+			throw std::bad_alloc();
+		}
+		if((mNextIndex >> kSlabShift) == mSlabs.size())
+		{
+			mSlabs.push_back(static_cast<CompactNode*>(::operator new(kSlabNodes * sizeof(CompactNode))));
+		}
+		index = mNextIndex++;
+	}
+
+	CompactNode& node = at(index);
+	try
+	{
+		new (&node.mItem) std::pair<Key, Value>(std::forward<Item>(item));
+
+	} catch(...) {
+
+		node.mLeft = mFreeList;
+		mFreeList = index;
+		throw;
+	}
+	node.mLeft = kNone;
+	node.mRight = kNone;
+	node.mParent = parent;
+	node.mBalance = 0;
+	return index;
+}
+
+/**
+* Destroys the item in a node and puts its slot on the free list.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::destroyNode(std::uint32_t index)
+{
+	CompactNode& node = at(index);
+	node.mItem.~pair();
+	node.mLeft = mFreeList;
+	mFreeList = index;
+}
+
+/**
+* Points the parent's link, or the root if there is no parent, that led
+* to from at to instead.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::replaceChild(std::uint32_t parent, std::uint32_t from, std::uint32_t to)
+{
+	if(parent == kNone)
+	{
+		mRoot = to;
+	}
+	else if(at(parent).mLeft == from)
+	{
+		at(parent).mLeft = to;
+	}
+	else
+	{
+		at(parent).mRight = to;
+	}
+}
+
+/**
+* Lifts the right child of a node above it. Balance factors are left to
+* the caller.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::rotateLeft(std::uint32_t index)
+{
+	CompactNode& node = at(index);
+	std::uint32_t child = node.mRight;
+	CompactNode& up = at(child);
+
+	node.mRight = up.mLeft;
+	if(up.mLeft != kNone)
+	{
+		at(up.mLeft).mParent = index;
+	}
+	up.mParent = node.mParent;
+	replaceChild(node.mParent, index, child);
+	up.mLeft = index;
+	node.mParent = child;
+}
+
+/**
+* Lifts the left child of a node above it. Balance factors are left to
+* the caller.
+*/
+template<typename Key, typename Value>
+void CompactAVLTree<Key, Value>::rotateRight(std::uint32_t index)
+{
+	CompactNode& node = at(index);
+	std::uint32_t child = node.mLeft;
+	CompactNode& up = at(child);
+
+	node.mLeft = up.mRight;
+	if(up.mRight != kNone)
+	{
+		at(up.mRight).mParent = index;
+	}
+	up.mParent = node.mParent;
+	replaceChild(node.mParent, index, child);
+	up.mRight = index;
+	node.mParent = child;
+}
+
+/**
+* Rotates a node tipped by two back into balance, with a double rotation
+* if its taller child leans the other way, and works out the new balance
+* factors from the old ones. Returns the node now on top; its balance is
+* 0 unless the subtree kept its height, which only happens on removal.
+*/
+template<typename Key, typename Value>
+std::uint32_t CompactAVLTree<Key, Value>::rebalance(std::uint32_t index)
+{
+	CompactNode& node = at(index);
+	if(node.mBalance > 0)
+	{
+		std::uint32_t child = node.mRight;
+		CompactNode& right = at(child);
+		if(right.mBalance >= 0)
+		{
+			rotateLeft(index);
+			bool even = right.mBalance == 0;
+			node.mBalance = even ? 1 : 0;
+			right.mBalance = even ? -1 : 0;
+			return child;
+		}
+
+		std::uint32_t grandchild = right.mLeft;
+		CompactNode& middle = at(grandchild);
+		rotateRight(child);
+		rotateLeft(index);
+		node.mBalance = middle.mBalance > 0 ? -1 : 0;
+		right.mBalance = middle.mBalance < 0 ? 1 : 0;
+		middle.mBalance = 0;
+		return grandchild;
+	}
+
+	std::uint32_t child = node.mLeft;
+	CompactNode& left = at(child);
+	if(left.mBalance <= 0)
+	{
+		rotateRight(index);
+		bool even = left.mBalance == 0;
+		node.mBalance = even ? -1 : 0;
+		left.mBalance = even ? 1 : 0;
+		return child;
+	}
+
+	std::uint32_t grandchild = left.mRight;
+	CompactNode& middle = at(grandchild);
+	rotateLeft(child);
+	rotateRight(index);
+	node.mBalance = middle.mBalance < 0 ? 1 : 0;
+	left.mBalance = middle.mBalance > 0 ? -1 : 0;
+	middle.mBalance = 0;
+	return grandchild;
+}
+
+/**
+* Copies the subtree of the other tree at the given index below parent,
+* returning the index of the copy's root.
+*/
+template<typename Key, typename Value>
+std::uint32_t CompactAVLTree<Key, Value>::cloneNodes(const CompactAVLTree<Key, Value>& other, std::uint32_t index, std::uint32_t parent)
+{
+	if(index == kNone)
+	{
+		return kNone;
+	}
+	const CompactNode& source = other.at(index);
+	std::uint32_t copy = createNode(source.mItem, parent);
+	at(copy).mBalance = source.mBalance;
+	std::uint32_t left = cloneNodes(other, source.mLeft, copy);
+	at(copy).mLeft = left;
+	std::uint32_t right = cloneNodes(other, source.mRight, copy);
+	at(copy).mRight = right;
+	return copy;
+}
+
+/**
+* Checks the subtree at the given index, whose keys must lie strictly
+* between low and high where those are given, and returns its height.
+*/
+template<typename Key, typename Value>
+int CompactAVLTree<Key, Value>::validateNode(std::uint32_t index, const Key* low, const Key* high, TreeStats& stats) const
+{
+	if(index == kNone)
+	{
+		return 0;
+	}
+	const CompactNode& node = at(index);
+	if((low && !(*low < node.mItem.first)) || (high && !(node.mItem.first < *high)))
+	{
+		stats.ordered = false;
+	}
+	if((node.mLeft != kNone && at(node.mLeft).mParent != index)
+		|| (node.mRight != kNone && at(node.mRight).mParent != index))
+	{
+		stats.linked = false;
+	}
+
+	int left = validateNode(node.mLeft, low, &node.mItem.first, stats);
+	int right = validateNode(node.mRight, &node.mItem.first, high, stats);
+	if(left - right > 1 || right - left > 1)
+	{
+		stats.balanced = false;
+	}
+	if(node.mBalance != right - left)
+	{
+		stats.heightsValid = false;
+	}
+	++stats.size;
+	return 1 + std::max(left, right);
+}
+
+/*
+	-------------------------------------------------
+	End implementations for the CompactAVLTree class.
+	-------------------------------------------------
+*/
+
+#endif
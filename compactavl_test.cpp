@@ -0,0 +1,149 @@
+#include "compactavl.h"
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+
+/*
+	Tests for CompactAVLTree: random inserts, overwrites and removes
+	checked against std::map, with lookups and lower bounds after every
+	step and iteration, copies and the tree's own invariants (including
+	the stored balance factors) every so often, plus sorted runs that
+	rotate at every step.
+*/
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	if(!ok)
+	{
+		std::printf("FAILED: %s\n", what);
+		++failures;
+	}
+}
+
+template<typename Key>
+static Key toKey(int i)
+{
+	return static_cast<Key>(i);
+}
+
+template<>
+std::string toKey<std::string>(int i)
+{
+	return std::to_string(100000 + i);
+}
+
+/**
+* Returns true if the tree holds exactly the items of the map, walking
+* forwards from begin() and backwards from end(), and is a valid AVL tree.
+*/
+template<typename Key>
+static bool sameItems(const CompactAVLTree<Key, int>& tree, const std::map<Key, int>& expected)
+{
+	TreeStats stats = tree.validate();
+	if(!stats.valid() || !stats.balanced || tree.size() != expected.size() || tree.empty() != expected.empty())
+	{
+		return false;
+	}
+	typename CompactAVLTree<Key, int>::const_iterator it = tree.begin();
+	for(typename std::map<Key, int>::const_iterator e = expected.begin(); e != expected.end(); ++e, ++it)
+	{
+		if(it == tree.end() || it->first != e->first || it->second != e->second)
+		{
+			return false;
+		}
+	}
+	if(it != tree.end())
+	{
+		return false;
+	}
+	for(typename std::map<Key, int>::const_reverse_iterator e = expected.rbegin(); e != expected.rend(); ++e)
+	{
+		--it;
+		if(it->first != e->first)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+* Runs the random workload on one key type, then fills and empties the
+* tree in key order.
+*/
+template<typename Key>
+static void testAgainstMap(const char* name)
+{
+	CompactAVLTree<Key, int> tree;
+	std::map<Key, int> expected;
+	std::mt19937 rng(1);
+	bool ok = true;
+
+	for(int i = 0; i < 100000 && ok; ++i)
+	{
+		Key key = toKey<Key>(rng() % 5000);
+		if(rng() % 3)
+		{
+			tree.insert(std::make_pair(key, i));
+			expected[key] = i;
+
+		} else {
+
+			tree.remove(key);
+			expected.erase(key);
+		}
+
+		Key probe = toKey<Key>(rng() % 5000);
+		typename CompactAVLTree<Key, int>::const_iterator found = tree.find(probe);
+		typename std::map<Key, int>::const_iterator match = expected.find(probe);
+		ok = (found == tree.end()) == (match == expected.end()) && (match == expected.end() || found->second == match->second);
+
+		typename CompactAVLTree<Key, int>::const_iterator lower = tree.lower_bound(probe);
+		typename std::map<Key, int>::const_iterator lowerMatch = expected.lower_bound(probe);
+		ok = ok && (lower == tree.end()) == (lowerMatch == expected.end()) && (lowerMatch == expected.end() || lower->first == lowerMatch->first);
+
+		if(i % 5000 == 0)
+		{
+			ok = ok && sameItems(tree, expected);
+
+			CompactAVLTree<Key, int> copy(tree);
+			CompactAVLTree<Key, int> moved(std::move(copy));
+			ok = ok && sameItems(moved, expected) && copy.empty();
+			copy = moved;
+			ok = ok && sameItems(copy, expected);
+		}
+	}
+	check(ok, name);
+
+	tree.clear();
+	expected.clear();
+	for(int i = 0; i < 20000; ++i)
+	{
+		tree.insert(std::make_pair(toKey<Key>(i), i));
+		expected[toKey<Key>(i)] = i;
+	}
+	ok = sameItems(tree, expected);
+	for(int i = 0; i < 20000; i += 2)
+	{
+		tree.remove(toKey<Key>(i));
+		expected.erase(toKey<Key>(i));
+	}
+	check(ok && sameItems(tree, expected), "sorted runs");
+}
+
+int main()
+{
+	testAgainstMap<int>("int keys");
+	testAgainstMap<std::uint64_t>("uint64 keys");
+	testAgainstMap<std::string>("string keys");
+
+	if(failures == 0)
+	{
+		std::printf("compactavl_test: all passed\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+#include "concurrentavl.h"
+#include <atomic>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+	Tests for ConcurrentAVLTree: a single threaded run checked against
+	std::map, and a run of several threads on a 95% read / 5% write mix
+	that checks every value and scan a reader sees. `make tsan-test`
+	builds this file with -fsanitize=thread, which reports any data race
+	between the readers and the writers.
+*/
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	if(!ok)
+	{
+		std::printf("FAILED: %s\n", what);
+		++failures;
+	}
+}
+
+static int toKey(int i, int)
+{
+	return i;
+}
+
+static std::string toKey(int i, const std::string&)
+{
+	return std::to_string(1000000 + i);
+}
+
+/**
+* Runs random inserts, overwrites and removes against both the tree and
+* a std::map, comparing lookups, scans and the tree's own invariants.
+*/
+template<typename Key>
+static void testAgainstMap(const char* name)
+{
+	ConcurrentAVLTree<Key, int> tree;
+	std::map<Key, int> expected;
+	std::mt19937 rng(3);
+	bool ok = true;
+
+	for(int i = 0; i < 100000 && ok; ++i)
+	{
+		Key key = toKey(rng() % 2000, Key());
+		if(rng() % 3)
+		{
+			tree.insert(std::make_pair(key, i));
+			expected[key] = i;
+
+		} else {
+
+			tree.remove(key);
+			expected.erase(key);
+		}
+
+		Key probe = toKey(rng() % 2000, Key());
+		int value = -1;
+		bool found = tree.find(probe, value);
+		typename std::map<Key, int>::const_iterator it = expected.find(probe);
+		ok = found == (it != expected.end()) && (!found || value == it->second) && tree.contains(probe) == found;
+
+		if(i % 5000 == 0)
+		{
+			TreeStats stats = tree.validate();
+			ok = ok && stats.valid() && stats.balanced && stats.size == expected.size();
+
+			typename std::map<Key, int>::const_iterator next = expected.begin();
+			tree.forEach([&](const std::pair<Key, int>& item) {
+				ok = ok && next != expected.end() && next->first == item.first && next->second == item.second;
+				if(next != expected.end())
+				{
+					++next;
+				}
+			});
+			ok = ok && next == expected.end();
+
+			Key low = toKey(500, Key());
+			Key high = toKey(1500, Key());
+			next = expected.lower_bound(low);
+			tree.forRange(low, high, [&](const std::pair<Key, int>& item) {
+				ok = ok && next != expected.end() && next->first == item.first;
+				if(next != expected.end())
+				{
+					++next;
+				}
+			});
+			ok = ok && (next == expected.end() || !(next->first < high));
+		}
+	}
+	check(ok, name);
+
+	tree.clear();
+	check(tree.validate().size == 0 && !tree.contains(toKey(1, Key())), "clear");
+}
+
+/**
+* Has several threads share a tree on a 95% read / 5% write mix. Present
+* keys are even and stay present; the writers insert, overwrite and
+* remove odd keys. Every value is the key times 16 plus a counter, so a
+* reader can tell a value that belongs to another key, and every scan
+* must come out in strictly increasing key order.
+*/
+template<typename Key>
+static void testMixedThreads(const char* name)
+{
+	const int kKeys = 20000;
+	const int kThreads = 8;
+	const int kOps = 20000;
+
+	ConcurrentAVLTree<Key, int> tree;
+	for(int i = 0; i < kKeys; i += 2)
+	{
+		tree.insert(std::make_pair(toKey(i, Key()), i * 16));
+	}
+
+	std::atomic<int> bad(0);
+	std::atomic<long> hits(0);
+	std::vector<std::thread> threads;
+	for(int t = 0; t < kThreads; ++t)
+	{
+		threads.push_back(std::thread([&, t]() {
+			std::mt19937 rng(t + 1);
+			long found = 0;
+			for(int i = 0; i < kOps; ++i)
+			{
+				int k = rng() % kKeys;
+				unsigned choice = rng() % 100;
+				if(choice < 95)
+				{
+					int value = -1;
+					if(tree.find(toKey(k, Key()), value))
+					{
+						++found;
+						bad += value / 16 != k;
+					}
+					else
+					{
+						bad += k % 2 == 0;
+					}
+				}
+				else if(choice < 97)
+				{
+					int odd = k | 1;
+					tree.insert(std::make_pair(toKey(odd, Key()), odd * 16 + i % 16));
+				}
+				else if(choice < 99)
+				{
+					tree.remove(toKey(k | 1, Key()));
+				}
+				else
+				{
+					bool first = true;
+					Key last = Key();
+					tree.forRange(toKey(k, Key()), toKey(k + 100, Key()), [&](const std::pair<Key, int>& item) {
+						bad += !first && !(last < item.first);
+						first = false;
+						last = item.first;
+					});
+				}
+			}
+			hits += found;
+		}));
+	}
+	for(std::size_t t = 0; t < threads.size(); ++t)
+	{
+		threads[t].join();
+	}
+
+	TreeStats stats = tree.validate();
+	check(bad == 0 && hits > 0 && stats.valid() && stats.balanced, name);
+}
+
+int main()
+{
+	testAgainstMap<int>("single thread, int keys");
+	testAgainstMap<std::string>("single thread, string keys");
+	testMixedThreads<int>("mixed threads, int keys");
+	testMixedThreads<std::string>("mixed threads, string keys");
+
+	if(failures == 0)
+	{
+		std::printf("concurrent_test: all passed\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,1014 @@
+#ifndef CONCURRENTAVL_H
+#define CONCURRENTAVL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "bst.h"
+#include "nodepool.h"
+
+/**
+* An AVL tree that many threads may read and write at once. Writers take
+* a mutex and serialize. Readers take no lock: they walk the tree through
+* atomic links and validate what they saw against a sequence counter (a
+* seqlock) that every write makes odd while it relinks and rotates nodes
+* and even again once it is done. A read that overlapped a write is
+* thrown away and retried.
+*
+* Three rules keep a racing reader from touching anything a writer is
+* storing to:
+*   - every link, and the root, is a std::atomic that writers store with
+*     release and readers load with acquire;
+*   - an item never changes once its node is linked in. Overwriting a
+*     value links in a fresh node in place of the old one;
+*   - a node that has been unlinked is retired rather than freed, and the
+*     retired nodes are only handed back to the pool after a grace period
+*     in which every reader that might still hold one has left.
+*
+* Readers announce themselves for the grace periods on counters striped
+* across cache lines, one per thread up to kReaderStripes threads, so
+* readers never write to a line another reader uses. Writers never wait
+* for readers except in a grace period, which comes once per
+* kRetireBatch retired nodes.
+*
+* Results are returned by copy, since a node may be retired by the next
+* write.
+*/
+template <class Key, class Value>
+class ConcurrentAVLTree
+{
+	public:
+		ConcurrentAVLTree();
+		~ConcurrentAVLTree();
+
+		void insert(const std::pair<Key, Value>& keyValuePair);
+		void insert(std::pair<Key, Value>&& keyValuePair);
+		void remove(const Key& key);
+		void clear();
+
+		bool find(const Key& key, Value& value) const;
+		bool contains(const Key& key) const;
+		template<typename Function>
+		void forEach(Function f) const;
+		template<typename Function>
+		void forRange(const Key& low, const Key& high, Function f) const;
+
+		TreeStats validate() const;
+
+	private:
+		ConcurrentAVLTree(const ConcurrentAVLTree&);
+		ConcurrentAVLTree& operator=(const ConcurrentAVLTree&);
+
+		/**
+		* A node of the tree. Readers only look at the item and the child
+		* links; the parent link and height belong to the writer, and the
+		* parent link chains the node onto the retired list once it is
+		* unlinked.
+		*/
+		struct ConcurrentNode
+		{
+			template<typename Item>
+			ConcurrentNode(Item&& item, ConcurrentNode* parent);
+
+			const std::pair<Key, Value> mItem;
+			std::atomic<ConcurrentNode*> mLeft;
+			std::atomic<ConcurrentNode*> mRight;
+			ConcurrentNode* mParent;
+			int mHeight;
+		};
+
+		/**
+		* Counts the calling thread in as a reader for as long as it is in
+		* scope, so that no node it reaches is freed under it.
+		*/
+		class ReadSection
+		{
+			public:
+				explicit ReadSection(const ConcurrentAVLTree& tree);
+				~ReadSection();
+
+			private:
+				std::atomic<std::uint32_t>* mCount;
+		};
+
+		/**
+		* Holds the write lock and keeps the version odd for as long as it
+		* is in scope, and frees the retired nodes when enough have built up.
+		*/
+		class WriteSection
+		{
+			public:
+				explicit WriteSection(ConcurrentAVLTree& tree);
+				~WriteSection();
+
+			private:
+				ConcurrentAVLTree& mTree;
+				std::lock_guard<std::mutex> mLock;
+		};
+
+		/**
+		* The reader counters for both grace period phases, padded so that
+		* no two stripes share a cache line.
+		*/
+		struct ReaderStripe
+		{
+			std::atomic<std::uint32_t> mCount[2];
+			char mPadding[64 - 2 * sizeof(std::atomic<std::uint32_t>)];
+		};
+
+		std::uint64_t beginRead() const;
+		bool endRead(std::uint64_t version) const;
+		static std::size_t readerStripe();
+		const ConcurrentNode* readFind(const Key& key) const;
+		bool collect(const Key* from, bool after, const Key* high,
+			std::vector<std::pair<Key, Value> >& items, bool& finished) const;
+		template<typename Function>
+		void scan(const Key* low, const Key* high, Function& f) const;
+
+		template<typename Item>
+		void insertItem(Item&& item);
+		ConcurrentNode* writerFind(const Key& key) const;
+		void replaceChild(ConcurrentNode* parent, ConcurrentNode* from, ConcurrentNode* to);
+		void adoptChildren(ConcurrentNode* from, ConcurrentNode* to);
+		void leftRotate(ConcurrentNode* node);
+		void rightRotate(ConcurrentNode* node);
+		ConcurrentNode* rebalance(ConcurrentNode* node);
+		void retrace(ConcurrentNode* node);
+		void retire(ConcurrentNode* node);
+		void reclaim();
+		void destroyNode(ConcurrentNode* node);
+
+		static int height(const ConcurrentNode* node);
+		static void fixHeight(ConcurrentNode* node);
+		static int balance(const ConcurrentNode* node);
+		int validateNode(const ConcurrentNode* node, const ConcurrentNode* parent,
+			const Key* low, const Key* high, TreeStats& stats) const;
+
+		static const int kMaxSteps = 128;
+		static const std::size_t kScanChunk = 64;
+		static const std::size_t kReaderStripes = 32;
+		static const std::size_t kRetireBatch = 256;
+
+		std::atomic<ConcurrentNode*> mRoot;
+		mutable std::mutex mWriteLock;
+		std::atomic<std::uint64_t> mVersion;
+		std::atomic<std::uint32_t> mPhase;
+		mutable ReaderStripe mReaders[kReaderStripes];
+		ConcurrentNode* mRetired;
+		std::size_t mRetiredCount;
+		std::size_t mSize;
+		NodePool mPool;
+};
+
+/*
+	------------------------------------------------------
+	Begin implementations for the ConcurrentAVLTree class.
+	------------------------------------------------------
+*/
+
+/**
+* Constructor for a node that is not linked in yet, as a leaf below parent.
+*/
+template<typename Key, typename Value>
+template<typename Item>
+ConcurrentAVLTree<Key, Value>::ConcurrentNode::ConcurrentNode(Item&& item, ConcurrentNode* parent)
+	: mItem(std::forward<Item>(item))
+	, mLeft(nullptr)
+	, mRight(nullptr)
+	, mParent(parent)
+	, mHeight(1)
+{
+
+}
+
+/**
+* Default constructor for an empty tree with no readers.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::ConcurrentAVLTree()
+	: mRoot(nullptr)
+	, mVersion(0)
+	, mPhase(0)
+	, mRetired(nullptr)
+	, mRetiredCount(0)
+	, mSize(0)
+{
+	for(std::size_t i = 0; i < kReaderStripes; ++i)
+	{
+		mReaders[i].mCount[0].store(0, std::memory_order_relaxed);
+		mReaders[i].mCount[1].store(0, std::memory_order_relaxed);
+	}
+}
+
+/**
+* Destructor. No other thread may be using the tree any more, so every
+* node, linked or retired, is destroyed at once.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::~ConcurrentAVLTree()
+{
+	std::vector<ConcurrentNode*> pending(1, mRoot.load(std::memory_order_relaxed));
+	while(!pending.empty())
+	{
+		ConcurrentNode* node = pending.back();
+		pending.pop_back();
+		if(node)
+		{
+			pending.push_back(node->mLeft.load(std::memory_order_relaxed));
+			pending.push_back(node->mRight.load(std::memory_order_relaxed));
+			destroyNode(node);
+		}
+	}
+	reclaim();
+}
+
+/**
+* Inserts a copy of the item, or replaces the value if the key is present.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+	WriteSection section(*this);
+	insertItem(keyValuePair);
+}
+
+/**
+* Moves the item into the tree, or replaces the value if the key is present.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+	WriteSection section(*this);
+	insertItem(std::move(keyValuePair));
+}
+
+/**
+* Removes the item with the given key, if any. A node with two children
+* is replaced by its predecessor node, which is relinked rather than
+* copied, since items never change in place.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::remove(const Key& key)
+{
+	WriteSection section(*this);
+	ConcurrentNode* node = writerFind(key);
+	if(node == nullptr)
+	{
+		return;
+	}
+
+	ConcurrentNode* left = node->mLeft.load(std::memory_order_relaxed);
+	ConcurrentNode* right = node->mRight.load(std::memory_order_relaxed);
+	ConcurrentNode* from;
+	if(left && right)
+	{
+		ConcurrentNode* pred = left;
+		while(ConcurrentNode* next = pred->mRight.load(std::memory_order_relaxed))
+		{
+			pred = next;
+		}
+
+		if(pred == left)
+		{
+			from = pred;
+
+		} else {
+
+			from = pred->mParent;
+			ConcurrentNode* child = pred->mLeft.load(std::memory_order_relaxed);
+			from->mRight.store(child, std::memory_order_release);
+			if(child)
+			{
+				child->mParent = from;
+			}
+			pred->mLeft.store(left, std::memory_order_release);
+			left->mParent = pred;
+		}
+		pred->mRight.store(right, std::memory_order_release);
+		right->mParent = pred;
+		pred->mParent = node->mParent;
+		pred->mHeight = node->mHeight;
+		replaceChild(node->mParent, node, pred);
+
+	} else {
+
+		ConcurrentNode* child = left ? left : right;
+		if(child)
+		{
+			child->mParent = node->mParent;
+		}
+		replaceChild(node->mParent, node, child);
+		from = node->mParent;
+	}
+
+	retire(node);
+	--mSize;
+	retrace(from);
+}
+
+/**
+* Removes every item. The nodes are retired like any other unlinked node,
+* since readers may still be walking them.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::clear()
+{
+	WriteSection section(*this);
+	std::vector<ConcurrentNode*> pending(1, mRoot.load(std::memory_order_relaxed));
+	mRoot.store(nullptr, std::memory_order_release);
+	while(!pending.empty())
+	{
+		ConcurrentNode* node = pending.back();
+		pending.pop_back();
+		if(node)
+		{
+			pending.push_back(node->mLeft.load(std::memory_order_relaxed));
+			pending.push_back(node->mRight.load(std::memory_order_relaxed));
+			retire(node);
+		}
+	}
+	mSize = 0;
+}
+
+/**
+* Copies the value stored under the key into 'value' and returns true,
+* or returns false if the key is absent.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+	ReadSection section(*this);
+	while(true)
+	{
+		std::uint64_t version = beginRead();
+		const ConcurrentNode* node = readFind(key);
+		if(endRead(version))
+		{
+			if(node)
+			{
+				value = node->mItem.second;
+			}
+			return node != nullptr;
+		}
+	}
+}
+
+/**
+* Returns true if the key is present.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::contains(const Key& key) const
+{
+	ReadSection section(*this);
+	while(true)
+	{
+		std::uint64_t version = beginRead();
+		bool found = readFind(key) != nullptr;
+		if(endRead(version))
+		{
+			return found;
+		}
+	}
+}
+
+/**
+* Calls f(item) for every item in key order, where item is a
+* std::pair<Key, Value>. See forRange.
+*/
+template<typename Key, typename Value>
+template<typename Function>
+void ConcurrentAVLTree<Key, Value>::forEach(Function f) const
+{
+	scan(nullptr, nullptr, f);
+}
+
+/**
+* Calls f(item) for every item with low <= key < high in key order. The
+* items are read in short runs, each of which is a consistent view of
+* the tree, so a long scan makes progress under a steady stream of
+* writes; an item written while the scan is underway may or may not be
+* seen. f runs outside any lock and may itself use the tree.
+*/
+template<typename Key, typename Value>
+template<typename Function>
+void ConcurrentAVLTree<Key, Value>::forRange(const Key& low, const Key& high, Function f) const
+{
+	if(low < high)
+	{
+		scan(&low, &high, f);
+	}
+}
+
+/**
+* Checks the order, links, heights and balance of the whole tree while
+* holding off writers.
+*/
+template<typename Key, typename Value>
+TreeStats ConcurrentAVLTree<Key, Value>::validate() const
+{
+	std::lock_guard<std::mutex> lock(mWriteLock);
+	TreeStats stats = {true, true, true, true, true, true, 0, 0};
+	stats.height = validateNode(mRoot.load(std::memory_order_relaxed), nullptr, nullptr, nullptr, stats);
+	stats.countsValid = stats.size == mSize;
+	return stats;
+}
+
+/**
+* Counts the calling thread in under the current grace period phase.
+*
+* This and reclaim() form a Dekker handshake, so both sides use
+* sequentially consistent operations: either the increment comes before
+* reclaim() flips the phase, and reclaim() sees it and waits, or it comes
+* after, and the check of the phase here sees the flip and starts over
+* under the new phase. In the second case the load of the phase also
+* acquires the flip, after which every retired node is unreachable.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::ReadSection::ReadSection(const ConcurrentAVLTree& tree)
+{
+	ReaderStripe& stripe = tree.mReaders[readerStripe()];
+	std::uint32_t phase = tree.mPhase.load(std::memory_order_relaxed);
+	while(true)
+	{
+		mCount = &stripe.mCount[phase];
+		mCount->fetch_add(1, std::memory_order_seq_cst);
+		std::uint32_t now = tree.mPhase.load(std::memory_order_seq_cst);
+		if(now == phase)
+		{
+			return;
+		}
+		mCount->fetch_sub(1, std::memory_order_release);
+		phase = now;
+	}
+}
+
+/**
+* Counts the reader out. The release pairs with the acquire in
+* reclaim()'s wait, so every load the reader made happens before the
+* nodes it may have reached are freed.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::ReadSection::~ReadSection()
+{
+	mCount->fetch_sub(1, std::memory_order_release);
+}
+
+/**
+* Takes the write lock and makes the version odd before any link is
+* stored. The release fence pairs with the acquire fence in endRead():
+* a reader that loaded any link this write stores is then bound to see
+* the odd version, or a later one, when it checks.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::WriteSection::WriteSection(ConcurrentAVLTree& tree)
+	: mTree(tree)
+	, mLock(tree.mWriteLock)
+{
+	mTree.mVersion.store(mTree.mVersion.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+/**
+* Makes the version even again, also when the write threw part way. The
+* release pairs with the acquire in beginRead(), so a read that starts
+* from this version sees every link the write stored. Only then, with
+* the version even so that no reader is held up behind it, does a full
+* batch of retired nodes wait out a grace period.
+*/
+template<typename Key, typename Value>
+ConcurrentAVLTree<Key, Value>::WriteSection::~WriteSection()
+{
+	mTree.mVersion.store(mTree.mVersion.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	if(mTree.mRetiredCount >= kRetireBatch)
+	{
+		mTree.reclaim();
+	}
+}
+
+/**
+* Waits until no write is in progress and returns the version to check against.
+*/
+template<typename Key, typename Value>
+std::uint64_t ConcurrentAVLTree<Key, Value>::beginRead() const
+{
+	std::uint64_t version = mVersion.load(std::memory_order_acquire);
+	while(version & 1)
+	{
+		std::this_thread::yield();
+		version = mVersion.load(std::memory_order_acquire);
+	}
+	return version;
+}
+
+/**
+* Returns true if no write started since beginRead returned the version,
+* meaning everything read in between was a consistent view. The acquire
+* fence pairs with the release fence in WriteSection's constructor.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::endRead(std::uint64_t version) const
+{
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return mVersion.load(std::memory_order_relaxed) == version;
+}
+
+/**
+* Returns the reader counters for the calling thread. Threads are dealt
+* the stripes in turn as they first read, so up to kReaderStripes
+* threads each get one to themselves.
+*/
+template<typename Key, typename Value>
+std::size_t ConcurrentAVLTree<Key, Value>::readerStripe()
+{
+	static std::atomic<std::size_t> next(0);
+	thread_local std::size_t stripe = next.fetch_add(1, std::memory_order_relaxed) % kReaderStripes;
+	return stripe;
+}
+
+/**
+* Finds the key for a read section: gives up, returning null, if the
+* walk runs longer than any consistent tree allows.
+*/
+template<typename Key, typename Value>
+const typename ConcurrentAVLTree<Key, Value>::ConcurrentNode* ConcurrentAVLTree<Key, Value>::readFind(const Key& key) const
+{
+	const ConcurrentNode* curr = mRoot.load(std::memory_order_acquire);
+	for(int steps = 0; curr && steps < kMaxSteps; ++steps)
+	{
+		if(key < curr->mItem.first)
+		{
+			curr = curr->mLeft.load(std::memory_order_acquire);
+
+		} else if(curr->mItem.first < key) {
+
+			curr = curr->mRight.load(std::memory_order_acquire);
+
+		} else {
+
+			return curr;
+		}
+	}
+	return nullptr;
+}
+
+/**
+* Appends up to kScanChunk items, starting at the first key not less
+* than *from (or greater, if 'after') and stopping before *high; null
+* bounds are open. Sets 'finished' if the range ran out. The walk keeps
+* its own stack of the nodes still to visit, since readers do not follow
+* parent links. Returns false if the stack outgrew any consistent tree,
+* which only happens on a torn view.
+*/
+template<typename Key, typename Value>
+bool ConcurrentAVLTree<Key, Value>::collect(const Key* from, bool after, const Key* high,
+	std::vector<std::pair<Key, Value> >& items, bool& finished) const
+{
+	const ConcurrentNode* path[kMaxSteps];
+	int depth = 0;
+	const ConcurrentNode* curr = mRoot.load(std::memory_order_acquire);
+	for(int steps = 0; curr; ++steps)
+	{
+		if(steps == kMaxSteps)
+		{
+			return false;
+		}
+		if(from == nullptr || (after ? *from < curr->mItem.first : !(curr->mItem.first < *from)))
+		{
+			path[depth++] = curr;
+			curr = curr->mLeft.load(std::memory_order_acquire);
+
+		} else {
+
+			curr = curr->mRight.load(std::memory_order_acquire);
+		}
+	}
+
+	finished = true;
+	while(depth > 0)
+	{
+		curr = path[--depth];
+		if(high && !(curr->mItem.first < *high))
+		{
+			return true;
+		}
+		if(items.size() == kScanChunk)
+		{
+			finished = false;
+			return true;
+		}
+		items.push_back(curr->mItem);
+
+		for(curr = curr->mRight.load(std::memory_order_acquire); curr; curr = curr->mLeft.load(std::memory_order_acquire))
+		{
+			if(depth == kMaxSteps)
+			{
+				return false;
+			}
+			path[depth++] = curr;
+		}
+	}
+	return true;
+}
+
+/**
+* Reads the range a chunk at a time, each chunk under its own read
+* section, and hands each chunk to f once it is known to be consistent.
+* The next chunk resumes after the last key delivered.
+*/
+template<typename Key, typename Value>
+template<typename Function>
+void ConcurrentAVLTree<Key, Value>::scan(const Key* low, const Key* high, Function& f) const
+{
+	std::vector<std::pair<Key, Value> > items;
+	items.reserve(kScanChunk);
+	const Key* from = low;
+	bool after = false;
+	Key resume;
+
+	while(true)
+	{
+		bool finished = false;
+		{
+			ReadSection section(*this);
+			while(true)
+			{
+				items.clear();
+				std::uint64_t version = beginRead();
+				bool complete = collect(from, after, high, items, finished);
+				if(endRead(version) && complete)
+				{
+					break;
+				}
+			}
+		}
+
+		for(std::size_t i = 0; i < items.size(); ++i)
+		{
+			f(items[i]);
+		}
+		if(finished || items.empty())
+		{
+			return;
+		}
+		resume = items.back().first;
+		from = &resume;
+		after = true;
+	}
+}
+
+/**
+* Walks down to the key. If it is present, a new node with the new item
+* takes the old node's place; otherwise a new leaf is hung and the
+* heights are fixed on the way back up.
+*/
+template<typename Key, typename Value>
+template<typename Item>
+void ConcurrentAVLTree<Key, Value>::insertItem(Item&& item)
+{
+	ConcurrentNode* parent = nullptr;
+	ConcurrentNode* curr = mRoot.load(std::memory_order_relaxed);
+	bool leftSide = false;
+	while(curr)
+	{
+		if(item.first < curr->mItem.first)
+		{
+			parent = curr;
+			curr = curr->mLeft.load(std::memory_order_relaxed);
+			leftSide = true;
+		}
+		else if(curr->mItem.first < item.first)
+		{
+			parent = curr;
+			curr = curr->mRight.load(std::memory_order_relaxed);
+			leftSide = false;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	void* block = mPool.allocate(sizeof(ConcurrentNode), alignof(ConcurrentNode));
+	ConcurrentNode* node;
+	try
+	{
+		node = new (block) ConcurrentNode(std::forward<Item>(item), parent);
+
+	} catch(...) {
+
+		mPool.deallocate(block);
+		throw;
+	}
+	if(curr)
+	{
+		adoptChildren(curr, node);
+		node->mHeight = curr->mHeight;
+		replaceChild(parent, curr, node);
+		retire(curr);
+		return;
+	}
+
+	if(parent == nullptr)
+	{
+		mRoot.store(node, std::memory_order_release);
+
+	} else if(leftSide) {
+
+		parent->mLeft.store(node, std::memory_order_release);
+
+	} else {
+
+		parent->mRight.store(node, std::memory_order_release);
+	}
+	++mSize;
+	retrace(parent);
+}
+
+/**
+* Finds the node holding the key from the writer's side, or null.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::ConcurrentNode* ConcurrentAVLTree<Key, Value>::writerFind(const Key& key) const
+{
+	ConcurrentNode* curr = mRoot.load(std::memory_order_relaxed);
+	while(curr)
+	{
+		if(key < curr->mItem.first)
+		{
+			curr = curr->mLeft.load(std::memory_order_relaxed);
+		}
+		else if(curr->mItem.first < key)
+		{
+			curr = curr->mRight.load(std::memory_order_relaxed);
+		}
+		else
+		{
+			break;
+		}
+	}
+	return curr;
+}
+
+/**
+* Points the parent's link, or the root if there is no parent, that led
+* to from at to instead.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::replaceChild(ConcurrentNode* parent, ConcurrentNode* from, ConcurrentNode* to)
+{
+	if(parent == nullptr)
+	{
+		mRoot.store(to, std::memory_order_release);
+	}
+	else if(parent->mLeft.load(std::memory_order_relaxed) == from)
+	{
+		parent->mLeft.store(to, std::memory_order_release);
+	}
+	else
+	{
+		parent->mRight.store(to, std::memory_order_release);
+	}
+}
+
+/**
+* Gives a new node, not linked in yet, the children and parent of 'from'.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::adoptChildren(ConcurrentNode* from, ConcurrentNode* to)
+{
+	ConcurrentNode* left = from->mLeft.load(std::memory_order_relaxed);
+	ConcurrentNode* right = from->mRight.load(std::memory_order_relaxed);
+	to->mLeft.store(left, std::memory_order_relaxed);
+	to->mRight.store(right, std::memory_order_relaxed);
+	if(left)
+	{
+		left->mParent = to;
+	}
+	if(right)
+	{
+		right->mParent = to;
+	}
+	to->mParent = from->mParent;
+}
+
+/**
+* Lifts the right child of a node above it and fixes both heights.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::leftRotate(ConcurrentNode* node)
+{
+	ConcurrentNode* up = node->mRight.load(std::memory_order_relaxed);
+	ConcurrentNode* middle = up->mLeft.load(std::memory_order_relaxed);
+
+	node->mRight.store(middle, std::memory_order_release);
+	if(middle)
+	{
+		middle->mParent = node;
+	}
+	up->mLeft.store(node, std::memory_order_release);
+	up->mParent = node->mParent;
+	replaceChild(node->mParent, node, up);
+	node->mParent = up;
+	fixHeight(node);
+	fixHeight(up);
+}
+
+/**
+* Lifts the left child of a node above it and fixes both heights.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::rightRotate(ConcurrentNode* node)
+{
+	ConcurrentNode* up = node->mLeft.load(std::memory_order_relaxed);
+	ConcurrentNode* middle = up->mRight.load(std::memory_order_relaxed);
+
+	node->mLeft.store(middle, std::memory_order_release);
+	if(middle)
+	{
+		middle->mParent = node;
+	}
+	up->mRight.store(node, std::memory_order_release);
+	up->mParent = node->mParent;
+	replaceChild(node->mParent, node, up);
+	node->mParent = up;
+	fixHeight(node);
+	fixHeight(up);
+}
+
+/**
+* Rotates a node whose subtrees differ in height by two back into
+* balance, and returns the node now on top.
+*/
+template<typename Key, typename Value>
+typename ConcurrentAVLTree<Key, Value>::ConcurrentNode* ConcurrentAVLTree<Key, Value>::rebalance(ConcurrentNode* node)
+{
+	if(balance(node) > 0)
+	{
+		ConcurrentNode* right = node->mRight.load(std::memory_order_relaxed);
+		if(balance(right) < 0)
+		{
+			rightRotate(right);
+		}
+		leftRotate(node);
+
+	} else {
+
+		ConcurrentNode* left = node->mLeft.load(std::memory_order_relaxed);
+		if(balance(left) > 0)
+		{
+			leftRotate(left);
+		}
+		rightRotate(node);
+	}
+	return node->mParent;
+}
+
+/**
+* Fixes heights and balance from the given node up to the root, stopping
+* as soon as a subtree ends up as high as it was before.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::retrace(ConcurrentNode* node)
+{
+	while(node)
+	{
+		int before = node->mHeight;
+		fixHeight(node);
+		if(balance(node) > 1 || balance(node) < -1)
+		{
+			node = rebalance(node);
+		}
+		if(node->mHeight == before)
+		{
+			return;
+		}
+		node = node->mParent;
+	}
+}
+
+/**
+* Puts an unlinked node on the retired list, where it stays readable
+* until the next grace period.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::retire(ConcurrentNode* node)
+{
+	node->mParent = mRetired;
+	mRetired = node;
+	++mRetiredCount;
+}
+
+/**
+* Waits out a grace period and frees every retired node. The phase flip
+* sends new readers to the other counters, so only the readers counted
+* in before it, which may still hold retired nodes, are waited for; see
+* ReadSection for the other half of the handshake. Called with the write
+* lock held and the version even.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::reclaim()
+{
+	std::uint32_t old = mPhase.load(std::memory_order_relaxed);
+	mPhase.store(old ^ 1, std::memory_order_seq_cst);
+	for(std::size_t i = 0; i < kReaderStripes; ++i)
+	{
+		while(mReaders[i].mCount[old].load(std::memory_order_seq_cst) != 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	while(mRetired)
+	{
+		ConcurrentNode* next = mRetired->mParent;
+		destroyNode(mRetired);
+		mRetired = next;
+	}
+	mRetiredCount = 0;
+}
+
+/**
+* Destroys a node and hands its memory back to the pool.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::destroyNode(ConcurrentNode* node)
+{
+	node->~ConcurrentNode();
+	mPool.deallocate(node);
+}
+
+/**
+* Returns the height of a subtree, 0 if it is empty.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::height(const ConcurrentNode* node)
+{
+	return node ? node->mHeight : 0;
+}
+
+/**
+* Recomputes a node's height from its children's.
+*/
+template<typename Key, typename Value>
+void ConcurrentAVLTree<Key, Value>::fixHeight(ConcurrentNode* node)
+{
+	node->mHeight = 1 + std::max(height(node->mLeft.load(std::memory_order_relaxed)),
+		height(node->mRight.load(std::memory_order_relaxed)));
+}
+
+/**
+* Returns the height of a node's right subtree minus that of its left.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::balance(const ConcurrentNode* node)
+{
+	return height(node->mRight.load(std::memory_order_relaxed)) - height(node->mLeft.load(std::memory_order_relaxed));
+}
+
+/**
+* Checks the subtree at node, whose keys must lie strictly between low
+* and high where those are given, and returns its measured height.
+*/
+template<typename Key, typename Value>
+int ConcurrentAVLTree<Key, Value>::validateNode(const ConcurrentNode* node, const ConcurrentNode* parent,
+	const Key* low, const Key* high, TreeStats& stats) const
+{
+	if(node == nullptr)
+	{
+		return 0;
+	}
+	if((low && !(*low < node->mItem.first)) || (high && !(node->mItem.first < *high)))
+	{
+		stats.ordered = false;
+	}
+	if(node->mParent != parent)
+	{
+		stats.linked = false;
+	}
+
+	int left = validateNode(node->mLeft.load(std::memory_order_relaxed), node, low, &node->mItem.first, stats);
+	int right = validateNode(node->mRight.load(std::memory_order_relaxed), node, &node->mItem.first, high, stats);
+	if(left - right > 1 || right - left > 1)
+	{
+		stats.balanced = false;
+	}
+	if(node->mHeight != 1 + std::max(left, right))
+	{
+		stats.heightsValid = false;
+	}
+	++stats.size;
+	return 1 + std::max(left, right);
+}
+
+/*
+	----------------------------------------------------
+	End implementations for the ConcurrentAVLTree class.
+	----------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,460 @@
+#ifndef EYTZINGER_H
+#define EYTZINGER_H
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include <iterator>
+
+/**
+* A read-only snapshot of a sorted map laid out in Eytzinger order: the
+* keys form an implicit complete binary search tree stored breadth first
+* in one array, with the children of slot k at 2k and 2k + 1 and no
+* pointers at all. The top levels of every search share a few cache
+* lines, the descent needs no branches, and the keys a few levels
+* further down are prefetched while the current level is compared.
+*
+* Keys and values live in separate arrays so that searches only touch
+* keys. Iterators walk the items in key order and hand out a pair of
+* references. Key and Value must be default constructible.
+*/
+template <typename Key, typename Value>
+class FrozenTree
+{
+	public:
+		FrozenTree();
+		template<typename ForwardIterator>
+		FrozenTree(ForwardIterator first, ForwardIterator last);
+
+		template<typename ForwardIterator>
+		void assign(ForwardIterator first, ForwardIterator last);
+		std::size_t size() const;
+		bool empty() const;
+
+	public:
+		/**
+		* A bidirectional iterator over the items in key order.
+		*/
+		class iterator
+		{
+			public:
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef std::pair<Key, Value> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef std::pair<const Key&, const Value&> reference;
+
+				/**
+				* What operator-> returns, so that it->second reaches the value.
+				*/
+				class pointer
+				{
+					public:
+						explicit pointer(const reference& item) : mItem(item) {}
+						const reference* operator->() const { return &mItem; }
+
+					private:
+						reference mItem;
+				};
+
+				iterator(std::size_t slot, const FrozenTree<Key, Value>* tree);
+				iterator();
+
+				reference operator*() const;
+				pointer operator->() const;
+
+				bool operator==(const iterator& rhs) const;
+				bool operator!=(const iterator& rhs) const;
+
+				iterator& operator++();
+				iterator operator++(int);
+				iterator& operator--();
+				iterator operator--(int);
+
+			protected:
+				std::size_t mSlot;
+				const FrozenTree<Key, Value>* mTree;
+		};
+
+		typedef iterator const_iterator;
+
+	public:
+		iterator begin() const;
+		iterator end() const;
+		iterator find(const Key& key) const;
+		iterator lower_bound(const Key& key) const;
+		iterator upper_bound(const Key& key) const;
+
+	protected:
+		std::size_t search(const Key& key, bool inclusive) const;
+		std::size_t firstSlot() const;
+		std::size_t lastSlot() const;
+		std::size_t nextSlot(std::size_t slot) const;
+		std::size_t prevSlot(std::size_t slot) const;
+
+	protected:
+		// Slot 0 is unused so that the children of slot k are 2k and 2k + 1;
+		// a search that runs off the tree ends at slot 0, the end iterator.
+		std::vector<Key> mKeys;
+		std::vector<Value> mValues;
+		std::size_t mSize;
+};
+
+/*
+	---------------------------------------------------------
+	Begin implementations for the FrozenTree::iterator class.
+	---------------------------------------------------------
+*/
+
+/**
+* Constructor for an iterator at the given slot. Slot 0 is the end.
+*/
+template<typename Key, typename Value>
+FrozenTree<Key, Value>::iterator::iterator(std::size_t slot, const FrozenTree<Key, Value>* tree)
+	: mSlot(slot)
+	, mTree(tree)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to the end of no tree.
+*/
+template<typename Key, typename Value>
+FrozenTree<Key, Value>::iterator::iterator()
+	: mSlot(0)
+	, mTree(nullptr)
+{
+
+}
+
+/**
+* Provides read-only access to the key and value of the item.
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator::reference FrozenTree<Key, Value>::iterator::operator*() const
+{
+	return reference(mTree->mKeys[mSlot], mTree->mValues[mSlot]);
+}
+
+/**
+* Provides read-only member access to the key and value of the item.
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator::pointer FrozenTree<Key, Value>::iterator::operator->() const
+{
+	return pointer(**this);
+}
+
+/**
+* Checks if 'this' iterator is at the same item as 'rhs'
+*/
+template<typename Key, typename Value>
+bool FrozenTree<Key, Value>::iterator::operator==(const iterator& rhs) const
+{
+	return mSlot == rhs.mSlot;
+}
+
+/**
+* Checks if 'this' iterator is at a different item than 'rhs'
+*/
+template<typename Key, typename Value>
+bool FrozenTree<Key, Value>::iterator::operator!=(const iterator& rhs) const
+{
+	return mSlot != rhs.mSlot;
+}
+
+/**
+* Advances to the next item in key order.
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator& FrozenTree<Key, Value>::iterator::operator++()
+{
+	mSlot = mTree->nextSlot(mSlot);
+	return *this;
+}
+
+/**
+* Advances the iterator, returning a copy of its old position.
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator FrozenTree<Key, Value>::iterator::operator++(int)
+{
+	iterator old(*this);
+	++(*this);
+	return old;
+}
+
+/**
+* Moves back to the previous item. The end iterator moves back to the largest item.
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator& FrozenTree<Key, Value>::iterator::operator--()
+{
+	mSlot = mSlot ? mTree->prevSlot(mSlot) : mTree->lastSlot();
+	return *this;
+}
+
+/**
+* Moves the iterator back, returning a copy of its old position.
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator FrozenTree<Key, Value>::iterator::operator--(int)
+{
+	iterator old(*this);
+	--(*this);
+	return old;
+}
+
+/*
+	-------------------------------------------------------
+	End implementations for the FrozenTree::iterator class.
+	-------------------------------------------------------
+*/
+
+/*
+	-----------------------------------------------
+	Begin implementations for the FrozenTree class.
+	-----------------------------------------------
+*/
+
+/**
+* Default constructor for an empty snapshot.
+*/
+template<typename Key, typename Value>
+FrozenTree<Key, Value>::FrozenTree()
+	: mKeys(1)
+	, mValues(1)
+	, mSize(0)
+{
+
+}
+
+/**
+* Builds a snapshot of the items in [first, last), which must be sorted
+* by strictly increasing key, as any tree's in-order iterators are.
+*/
+template<typename Key, typename Value>
+template<typename ForwardIterator>
+FrozenTree<Key, Value>::FrozenTree(ForwardIterator first, ForwardIterator last)
+	: mSize(0)
+{
+	assign(first, last);
+}
+
+/**
+* Replaces the contents with the sorted items in [first, last) in O(n).
+* The slots are filled in their own in-order sequence, so each item is
+* read once and written straight to its place.
+*/
+template<typename Key, typename Value>
+template<typename ForwardIterator>
+void FrozenTree<Key, Value>::assign(ForwardIterator first, ForwardIterator last)
+{
+	mSize = std::distance(first, last);
+	mKeys.assign(mSize + 1, Key());
+	mValues.assign(mSize + 1, Value());
+
+	for(std::size_t slot = firstSlot(); first != last; ++first)
+	{
+		mKeys[slot] = first->first;
+		mValues[slot] = first->second;
+		slot = nextSlot(slot);
+	}
+}
+
+/**
+* Returns the number of items.
+*/
+template<typename Key, typename Value>
+std::size_t FrozenTree<Key, Value>::size() const
+{
+	return mSize;
+}
+
+/**
+* Returns true if the snapshot holds no items.
+*/
+template<typename Key, typename Value>
+bool FrozenTree<Key, Value>::empty() const
+{
+	return mSize == 0;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator FrozenTree<Key, Value>::begin() const
+{
+	return iterator(firstSlot(), this);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator FrozenTree<Key, Value>::end() const
+{
+	return iterator(0, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the snapshot
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator FrozenTree<Key, Value>::find(const Key& key) const
+{
+	std::size_t slot = search(key, false);
+	return iterator(slot && !(key < mKeys[slot]) ? slot : 0, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than the
+* given key, or the end iterator if there is none.
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator FrozenTree<Key, Value>::lower_bound(const Key& key) const
+{
+	return iterator(search(key, false), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than the
+* given key, or the end iterator if there is none.
+*/
+template<typename Key, typename Value>
+typename FrozenTree<Key, Value>::iterator FrozenTree<Key, Value>::upper_bound(const Key& key) const
+{
+	return iterator(search(key, true), this);
+}
+
+/**
+* Descends from the root, going right whenever the slot's key sorts
+* before the search key (is less than it, or also equal if inclusive),
+* without branching on the outcome. The bits of the final slot record
+* the turns taken, and stripping the trailing right turns plus the last
+* left turn lands on the answer: the last slot where the search went
+* left, or 0 if it never did.
+*/
+template<typename Key, typename Value>
+std::size_t FrozenTree<Key, Value>::search(const Key& key, bool inclusive) const
+{
+	// The descendants d levels below slot k fill slots k * 2^d onward, so
+	// with 2^d keys to a cache line one prefetch fetches all of them in
+	// time for the search to get there.
+	static const std::size_t kPrefetchStride = sizeof(Key) >= 32 ? 2 : 64 / sizeof(Key);
+
+	const Key* keys = mKeys.data();
+	std::size_t slot = 1;
+	while(slot <= mSize)
+	{
+#if defined(__GNUC__)
+		__builtin_prefetch(reinterpret_cast<const char*>(keys) + slot * kPrefetchStride * sizeof(Key));
+#endif
+		slot = 2 * slot + (inclusive ? !(key < keys[slot]) : keys[slot] < key);
+	}
+
+	// Shift off the trailing ones (right turns) together with the zero
+	// (left turn) above them.
+#if defined(__GNUC__)
+	return slot >> __builtin_ffsll(~static_cast<long long>(slot));
+#else
+	std::size_t shift = 1;
+	while(slot & (std::size_t(1) << (shift - 1)))
+	{
+		++shift;
+	}
+	return slot >> shift;
+#endif
+}
+
+/**
+* Returns the slot of the smallest key, the leftmost one, or 0 if empty.
+*/
+template<typename Key, typename Value>
+std::size_t FrozenTree<Key, Value>::firstSlot() const
+{
+	if(mSize == 0)
+	{
+		return 0;
+	}
+	std::size_t slot = 1;
+	while(2 * slot <= mSize)
+	{
+		slot = 2 * slot;
+	}
+	return slot;
+}
+
+/**
+* Returns the slot of the largest key, the rightmost one, or 0 if empty.
+*/
+template<typename Key, typename Value>
+std::size_t FrozenTree<Key, Value>::lastSlot() const
+{
+	if(mSize == 0)
+	{
+		return 0;
+	}
+	std::size_t slot = 1;
+	while(2 * slot + 1 <= mSize)
+	{
+		slot = 2 * slot + 1;
+	}
+	return slot;
+}
+
+/**
+* Returns the in-order successor of a slot, or 0 after the last one: the
+* leftmost slot of the right subtree if there is one, otherwise the
+* nearest ancestor reached from its left.
+*/
+template<typename Key, typename Value>
+std::size_t FrozenTree<Key, Value>::nextSlot(std::size_t slot) const
+{
+	if(2 * slot + 1 <= mSize)
+	{
+		slot = 2 * slot + 1;
+		while(2 * slot <= mSize)
+		{
+			slot = 2 * slot;
+		}
+		return slot;
+	}
+	while(slot & 1)
+	{
+		slot >>= 1;
+	}
+	return slot >> 1;
+}
+
+/**
+* Returns the in-order predecessor of a slot, or 0 before the first one.
+*/
+template<typename Key, typename Value>
+std::size_t FrozenTree<Key, Value>::prevSlot(std::size_t slot) const
+{
+	if(2 * slot <= mSize)
+	{
+		slot = 2 * slot;
+		while(2 * slot + 1 <= mSize)
+		{
+			slot = 2 * slot + 1;
+		}
+		return slot;
+	}
+	while(slot > 1 && !(slot & 1))
+	{
+		slot >>= 1;
+	}
+	return slot >> 1;
+}
+
+/*
+	---------------------------------------------
+	End implementations for the FrozenTree class.
+	---------------------------------------------
+*/
+
+#endif
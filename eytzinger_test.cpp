@@ -0,0 +1,121 @@
+#include "avlbst.h"
+#include <cstdio>
+#include <map>
+#include <random>
+
+/*
+	Tests for FrozenTree: snapshots of every size up to a few levels, and
+	of a larger random tree, checked against std::map for lookups, bounds
+	and iteration in both directions, whether built by freeze() or from a
+	sorted range.
+*/
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	if(!ok)
+	{
+		std::printf("FAILED: %s\n", what);
+		++failures;
+	}
+}
+
+/**
+* Returns true if every query the snapshot answers agrees with the map.
+* The keys in the map are even, so odd probes cover the misses and every
+* gap between two keys.
+*/
+static bool agrees(const FrozenTree<int, int>& frozen, const std::map<int, int>& expected, int limit)
+{
+	if(frozen.size() != expected.size() || frozen.empty() != expected.empty())
+	{
+		return false;
+	}
+
+	FrozenTree<int, int>::iterator it = frozen.begin();
+	for(std::map<int, int>::const_iterator e = expected.begin(); e != expected.end(); ++e, ++it)
+	{
+		if(it == frozen.end() || it->first != e->first || it->second != e->second)
+		{
+			return false;
+		}
+	}
+	if(it != frozen.end())
+	{
+		return false;
+	}
+	for(std::map<int, int>::const_reverse_iterator e = expected.rbegin(); e != expected.rend(); ++e)
+	{
+		--it;
+		if(it->first != e->first)
+		{
+			return false;
+		}
+	}
+
+	for(int probe = -1; probe <= limit + 1; ++probe)
+	{
+		FrozenTree<int, int>::iterator found = frozen.find(probe);
+		std::map<int, int>::const_iterator match = expected.find(probe);
+		if((found == frozen.end()) != (match == expected.end()) || (match != expected.end() && found->second != match->second))
+		{
+			return false;
+		}
+
+		FrozenTree<int, int>::iterator lower = frozen.lower_bound(probe);
+		std::map<int, int>::const_iterator lowerMatch = expected.lower_bound(probe);
+		if((lower == frozen.end()) != (lowerMatch == expected.end()) || (lowerMatch != expected.end() && lower->first != lowerMatch->first))
+		{
+			return false;
+		}
+
+		FrozenTree<int, int>::iterator upper = frozen.upper_bound(probe);
+		std::map<int, int>::const_iterator upperMatch = expected.upper_bound(probe);
+		if((upper == frozen.end()) != (upperMatch == expected.end()) || (upperMatch != expected.end() && upper->first != upperMatch->first))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+int main()
+{
+	// Every size up to 70 covers full, partial and single leaf levels.
+	bool ok = true;
+	for(int n = 0; n <= 70 && ok; ++n)
+	{
+		AVLTree<int, int> tree;
+		std::map<int, int> expected;
+		for(int i = 0; i < n; ++i)
+		{
+			tree.insert(std::make_pair(2 * i, i));
+			expected[2 * i] = i;
+		}
+		ok = agrees(tree.freeze(), expected, 2 * n);
+		ok = ok && agrees(FrozenTree<int, int>(expected.begin(), expected.end()), expected, 2 * n);
+	}
+	check(ok, "every small size");
+
+	AVLTree<int, int> tree;
+	std::map<int, int> expected;
+	std::mt19937 rng(11);
+	for(int i = 0; i < 20000; ++i)
+	{
+		int key = 2 * static_cast<int>(rng() % 50000);
+		tree.insert(std::make_pair(key, i));
+		expected[key] = i;
+	}
+	FrozenTree<int, int> frozen = tree.freeze();
+	check(agrees(frozen, expected, 100000), "random tree");
+
+	frozen.assign(expected.begin(), expected.begin());
+	check(agrees(frozen, std::map<int, int>(), 4), "assign empty");
+
+	if(failures == 0)
+	{
+		std::printf("eytzinger_test: all passed\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+#ifndef NODEPOOL_H
+#define NODEPOOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <new>
+
+/**
+* The interface a search tree obtains the memory for its nodes from.
+* Trees construct nodes in place inside the blocks handed out here
+* and return each block through deallocate() once the node is destroyed.
+*/
+class NodeAllocator
+{
+public:
+	virtual ~NodeAllocator();
+
+	virtual void* allocate(std::size_t bytes, std::size_t align) = 0;
+	virtual void deallocate(void* block) = 0;
+	virtual bool release();
+	virtual bool absorb(NodeAllocator& other);
+};
+
+/**
+* An allocator that forwards every request to the global heap. This is
+* the behaviour the trees had before allocators were pluggable.
+*/
+class HeapNodeAllocator : public NodeAllocator
+{
+public:
+	virtual void* allocate(std::size_t bytes, std::size_t align) override;
+	virtual void deallocate(void* block) override;
+	virtual bool absorb(NodeAllocator& other) override;
+};
+
+/**
+* A slab allocator for fixed size blocks. Blocks are carved out of large
+* slabs and freed blocks are recycled through an intrusive free list, so
+* nodes end up packed together instead of scattered across the heap.
+* The block size is fixed by the first call to allocate(), which means a
+* pool serves exactly one node type.
+*/
+class NodePool : public NodeAllocator
+{
+public:
+	NodePool();
+	virtual ~NodePool();
+
+	virtual void* allocate(std::size_t bytes, std::size_t align) override;
+	virtual void deallocate(void* block) override;
+	virtual bool release() override;
+	virtual bool absorb(NodeAllocator& other) override;
+
+private:
+	NodePool(const NodePool&);
+	NodePool& operator=(const NodePool&);
+
+	struct Slab
+	{
+		Slab* mNext;
+	};
+
+	struct FreeBlock
+	{
+		FreeBlock* mNext;
+	};
+
+	void grow();
+
+	static const std::size_t kFirstSlabBlocks = 64;
+	static const std::size_t kMaxSlabBlocks = 16384;
+
+	std::size_t mBlockSize;
+	std::size_t mAlign;
+	std::size_t mSlabBlocks;
+	Slab* mSlabs;
+	FreeBlock* mFree;
+	char* mNextBlock;
+	char* mSlabEnd;
+};
+
+/*
+	----------------------------------------------
+	Begin implementations for the allocator classes.
+	----------------------------------------------
+*/
+
+inline NodeAllocator::~NodeAllocator()
+{
+
+}
+
+/**
+* Frees every block handed out by this allocator at once. Returns false
+* if the allocator cannot do so, in which case the caller has to
+* deallocate each block on its own.
+*/
+inline bool NodeAllocator::release()
+{
+	return false;
+}
+
+/**
+* Takes over every block the other allocator has handed out, so that
+* they may be returned here instead, and leaves the other one empty.
+* Returns false if the blocks cannot be taken over, in which case
+* nothing changes.
+*/
+inline bool NodeAllocator::absorb(NodeAllocator&)
+{
+	return false;
+}
+
+inline void* HeapNodeAllocator::allocate(std::size_t bytes, std::size_t)
+{
+	return ::operator new(bytes);
+}
+
+inline void HeapNodeAllocator::deallocate(void* block)
+{
+	::operator delete(block);
+}
+
+/**
+* Blocks from one global heap allocator can go back through any other.
+*/
+inline bool HeapNodeAllocator::absorb(NodeAllocator& other)
+{
+	return dynamic_cast<HeapNodeAllocator*>(&other) != nullptr;
+}
+
+/**
+* Creates an empty pool. No memory is reserved until the first allocation.
+*/
+inline NodePool::NodePool()
+	: mBlockSize(0)
+	, mAlign(0)
+	, mSlabBlocks(kFirstSlabBlocks)
+	, mSlabs(nullptr)
+	, mFree(nullptr)
+	, mNextBlock(nullptr)
+	, mSlabEnd(nullptr)
+{
+
+}
+
+inline NodePool::~NodePool()
+{
+	release();
+}
+
+/**
+* Hands out a block, preferring recently freed ones. Requests for a
+* different size than the one the pool was set up with are refused.
+*/
+inline void* NodePool::allocate(std::size_t bytes, std::size_t align)
+{
+	if(mBlockSize == 0)
+	{
+		mAlign = align < alignof(FreeBlock) ? alignof(FreeBlock) : align;
+		std::size_t size = bytes < sizeof(FreeBlock) ? sizeof(FreeBlock) : bytes;
+		mBlockSize = (size + mAlign - 1) / mAlign * mAlign;
+	}
+	else if(bytes > mBlockSize || align > mAlign)
+	{
+		throw std::bad_alloc();
+	}
+
+	if(mFree)
+	{
+		FreeBlock* block = mFree;
+		mFree = block->mNext;
+		return block;
+	}
+
+	if(mNextBlock == mSlabEnd)
+	{
+		grow();
+	}
+	void* block = mNextBlock;
+	mNextBlock += mBlockSize;
+	return block;
+}
+
+/**
+* Returns a block to the free list so the next allocation can reuse it.
+*/
+inline void NodePool::deallocate(void* block)
+{
+	FreeBlock* freed = static_cast<FreeBlock*>(block);
+	freed->mNext = mFree;
+	mFree = freed;
+}
+
+/**
+* Drops every slab in one sweep. Any node still living in the pool is
+* gone afterwards, so only the sole owner of the pool may call this.
+*/
+inline bool NodePool::release()
+{
+	while(mSlabs)
+	{
+		Slab* next = mSlabs->mNext;
+		::operator delete(mSlabs);
+		mSlabs = next;
+	}
+	mSlabBlocks = kFirstSlabBlocks;
+	mFree = nullptr;
+	mNextBlock = nullptr;
+	mSlabEnd = nullptr;
+	return true;
+}
+
+/**
+* Moves the slabs and free blocks of another pool of the same block size
+* into this one. The live blocks are not touched, so this takes time in
+* the number of slabs and spare blocks only, however many nodes the
+* other pool holds.
+*/
+inline bool NodePool::absorb(NodeAllocator& other)
+{
+	NodePool* pool = dynamic_cast<NodePool*>(&other);
+	if(pool == nullptr || pool == this)
+	{
+		return pool == this;
+	}
+	if(pool->mSlabs == nullptr)
+	{
+		return true;
+	}
+	if(mBlockSize == 0)
+	{
+		mBlockSize = pool->mBlockSize;
+		mAlign = pool->mAlign;
+	}
+	else if(mBlockSize != pool->mBlockSize || mAlign != pool->mAlign)
+	{
+		return false;
+	}
+
+	// The unused end of the other pool's newest slab becomes free blocks.
+	for(; pool->mNextBlock != pool->mSlabEnd; pool->mNextBlock += mBlockSize)
+	{
+		pool->deallocate(pool->mNextBlock);
+	}
+
+	Slab* lastSlab = pool->mSlabs;
+	while(lastSlab->mNext)
+	{
+		lastSlab = lastSlab->mNext;
+	}
+	lastSlab->mNext = mSlabs;
+	mSlabs = pool->mSlabs;
+
+	if(pool->mFree)
+	{
+		FreeBlock* lastFree = pool->mFree;
+		while(lastFree->mNext)
+		{
+			lastFree = lastFree->mNext;
+		}
+		lastFree->mNext = mFree;
+		mFree = pool->mFree;
+	}
+
+	mSlabBlocks = std::max(mSlabBlocks, pool->mSlabBlocks);
+	pool->mSlabBlocks = kFirstSlabBlocks;
+	pool->mSlabs = nullptr;
+	pool->mFree = nullptr;
+	pool->mNextBlock = nullptr;
+	pool->mSlabEnd = nullptr;
+	return true;
+}
+
+/**
+* Allocates a new slab, doubling the slab size each time up to a cap so
+* that large trees need only a handful of calls into the global heap.
+*/
+inline void NodePool::grow()
+{
+	std::size_t header = (sizeof(Slab) + mAlign - 1) / mAlign * mAlign;
+	char* raw = static_cast<char*>(::operator new(header + mSlabBlocks * mBlockSize));
+
+	Slab* slab = reinterpret_cast<Slab*>(raw);
+	slab->mNext = mSlabs;
+	mSlabs = slab;
+
+	mNextBlock = raw + header;
+	mSlabEnd = mNextBlock + mSlabBlocks * mBlockSize;
+
+	if(mSlabBlocks < kMaxSlabBlocks)
+	{
+		mSlabBlocks *= 2;
+	}
+}
+
+/*
+	--------------------------------------------
+	End implementations for the allocator classes.
+	--------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,862 @@
+#ifndef PERSISTENTAVL_H
+#define PERSISTENTAVL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+* A node of a PersistentAVLTree. Once a node is reachable from a tree it
+* never changes again, so any number of tree versions can share it. The
+* reference count says how many parents and trees point at it.
+*/
+template <typename Key, typename Value>
+class PersistentNode
+{
+public:
+	template<typename Item>
+	PersistentNode(Item&& item, PersistentNode<Key, Value>* left, PersistentNode<Key, Value>* right);
+
+	const std::pair<Key, Value>& getItem() const;
+	const Key& getKey() const;
+	const Value& getValue() const;
+	const PersistentNode<Key, Value>* getLeft() const;
+	const PersistentNode<Key, Value>* getRight() const;
+	int getHeight() const;
+
+protected:
+	template <typename K, typename V> friend class PersistentAVLTree;
+
+	std::pair<Key, Value> mItem;
+	PersistentNode<Key, Value>* mLeft;
+	PersistentNode<Key, Value>* mRight;
+	int mHeight;
+	std::atomic<std::size_t> mRefs;
+};
+
+/*
+	---------------------------------------------------
+	Begin implementations for the PersistentNode class.
+	---------------------------------------------------
+*/
+
+/**
+* Constructor for a node that takes over one reference to each child.
+* Its height follows from theirs.
+*/
+template<typename Key, typename Value>
+template<typename Item>
+PersistentNode<Key, Value>::PersistentNode(Item&& item, PersistentNode<Key, Value>* left, PersistentNode<Key, Value>* right)
+	: mItem(std::forward<Item>(item))
+	, mLeft(left)
+	, mRight(right)
+	, mHeight(1 + std::max(left ? left->mHeight : 0, right ? right->mHeight : 0))
+	, mRefs(1)
+{
+
+}
+
+/**
+* A const getter for the item.
+*/
+template<typename Key, typename Value>
+const std::pair<Key, Value>& PersistentNode<Key, Value>::getItem() const
+{
+	return mItem;
+}
+
+/**
+* A const getter for the key.
+*/
+template<typename Key, typename Value>
+const Key& PersistentNode<Key, Value>::getKey() const
+{
+	return mItem.first;
+}
+
+/**
+* A const getter for the value.
+*/
+template<typename Key, typename Value>
+const Value& PersistentNode<Key, Value>::getValue() const
+{
+	return mItem.second;
+}
+
+/**
+* A getter for the left child.
+*/
+template<typename Key, typename Value>
+const PersistentNode<Key, Value>* PersistentNode<Key, Value>::getLeft() const
+{
+	return mLeft;
+}
+
+/**
+* A getter for the right child.
+*/
+template<typename Key, typename Value>
+const PersistentNode<Key, Value>* PersistentNode<Key, Value>::getRight() const
+{
+	return mRight;
+}
+
+/**
+* A getter for the height of the subtree rooted here.
+*/
+template<typename Key, typename Value>
+int PersistentNode<Key, Value>::getHeight() const
+{
+	return mHeight;
+}
+
+/*
+	-------------------------------------------------
+	End implementations for the PersistentNode class.
+	-------------------------------------------------
+*/
+
+/**
+* An AVL tree in which every version lives on. An update copies only the
+* O(log n) nodes on the path from the root to the change, and rebuilds
+* the rotations on that path from fresh nodes; every other subtree is
+* shared with the previous version. snapshot() and copying a tree are
+* therefore O(1), and a snapshot keeps seeing exactly the items it was
+* taken with however the original changes afterwards.
+*
+* Nodes are reference counted, so a node is freed as soon as the last
+* version that uses it is gone. The counts are atomic: separate tree
+* objects sharing nodes may be read, written and destroyed on different
+* threads, though one tree object is not safe to write from two threads.
+* An iterator stays valid until the tree it came from is modified;
+* iterate over a snapshot to read a version while it is being updated.
+*/
+template <typename Key, typename Value>
+class PersistentAVLTree
+{
+	public:
+		PersistentAVLTree();
+		PersistentAVLTree(const PersistentAVLTree<Key, Value>& other);
+		PersistentAVLTree(PersistentAVLTree<Key, Value>&& other);
+		~PersistentAVLTree();
+		PersistentAVLTree<Key, Value>& operator=(const PersistentAVLTree<Key, Value>& other);
+		PersistentAVLTree<Key, Value>& operator=(PersistentAVLTree<Key, Value>&& other);
+
+		PersistentAVLTree<Key, Value> snapshot() const;
+		void insert(const std::pair<Key, Value>& keyValuePair);
+		void insert(std::pair<Key, Value>&& keyValuePair);
+		void remove(const Key& key);
+		void clear();
+		std::size_t size() const;
+		bool empty() const;
+		TreeStats validate() const;
+
+	public:
+		/**
+		* A read-only bidirectional iterator over the items in key order.
+		* Nodes have no parent pointers, since a shared node has a parent
+		* in every version, so the iterator carries its path from the root.
+		* The path is only built once the iterator first moves, which keeps
+		* find() and lower_bound() free of allocations.
+		*/
+		class const_iterator
+		{
+			public:
+				typedef std::bidirectional_iterator_tag iterator_category;
+				typedef std::pair<Key, Value> value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef const std::pair<Key, Value>* pointer;
+				typedef const std::pair<Key, Value>& reference;
+
+				const_iterator(const PersistentNode<Key, Value>* node, const PersistentNode<Key, Value>* root);
+				const_iterator();
+
+				const std::pair<Key, Value>& operator*() const;
+				const std::pair<Key, Value>* operator->() const;
+
+				bool operator==(const const_iterator& rhs) const;
+				bool operator!=(const const_iterator& rhs) const;
+
+				const_iterator& operator++();
+				const_iterator operator++(int);
+				const_iterator& operator--();
+				const_iterator operator--(int);
+
+			protected:
+				void descend(const PersistentNode<Key, Value>* node, bool leftward);
+				void buildPath();
+
+				// mPath is either empty or runs from the root down to mNode.
+				std::vector<const PersistentNode<Key, Value>*> mPath;
+				const PersistentNode<Key, Value>* mNode;
+				const PersistentNode<Key, Value>* mRoot;
+
+				friend class PersistentAVLTree<Key, Value>;
+		};
+
+		typedef const_iterator iterator;
+
+	public:
+		const_iterator begin() const;
+		const_iterator end() const;
+		const_iterator find(const Key& key) const;
+		const_iterator lower_bound(const Key& key) const;
+
+	protected:
+		typedef PersistentNode<Key, Value> NodeType;
+
+		static NodeType* retain(NodeType* node);
+		static void release(NodeType* node);
+		static int heightOf(const NodeType* node);
+		template<typename Item>
+		static NodeType* balance(Item&& item, NodeType* left, NodeType* right);
+		template<typename Item>
+		static NodeType* insertAt(NodeType* node, Item&& item, bool& added);
+		static NodeType* removeAt(NodeType* node, const Key& key);
+		static NodeType* removeMin(NodeType* node, const std::pair<Key, Value>*& minItem);
+		const NodeType* internalFind(const Key& key) const;
+		int validateNode(const NodeType* node, const Key* low, const Key* high, TreeStats& stats) const;
+
+	protected:
+		NodeType* mRoot;
+		std::size_t mSize;
+};
+
+/*
+	-------------------------------------------------------------------
+	Begin implementations for the PersistentAVLTree::const_iterator class.
+	-------------------------------------------------------------------
+*/
+
+/**
+* Constructor for an iterator at the given node, or at the end if it is
+* null, of the tree with the given root.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::const_iterator::const_iterator(const PersistentNode<Key, Value>* node, const PersistentNode<Key, Value>* root)
+	: mNode(node)
+	, mRoot(root)
+{
+
+}
+
+/**
+* A default constructor that initializes the iterator to the end of no tree.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::const_iterator::const_iterator()
+	: mNode(nullptr)
+	, mRoot(nullptr)
+{
+
+}
+
+/**
+* Provides read-only access to the item.
+*/
+template<typename Key, typename Value>
+const std::pair<Key, Value>& PersistentAVLTree<Key, Value>::const_iterator::operator*() const
+{
+	return mNode->getItem();
+}
+
+/**
+* Provides the address of the item.
+*/
+template<typename Key, typename Value>
+const std::pair<Key, Value>* PersistentAVLTree<Key, Value>::const_iterator::operator->() const
+{
+	return &(mNode->getItem());
+}
+
+/**
+* Checks if 'this' const_iterator is at the same item as 'rhs'
+*/
+template<typename Key, typename Value>
+bool PersistentAVLTree<Key, Value>::const_iterator::operator==(const const_iterator& rhs) const
+{
+	return mNode == rhs.mNode;
+}
+
+/**
+* Checks if 'this' const_iterator is at a different item than 'rhs'
+*/
+template<typename Key, typename Value>
+bool PersistentAVLTree<Key, Value>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+	return !(*this == rhs);
+}
+
+/**
+* Advances to the in-order successor: the leftmost node of the right
+* subtree, or else the nearest ancestor whose left subtree we are in.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::const_iterator& PersistentAVLTree<Key, Value>::const_iterator::operator++()
+{
+	buildPath();
+	const PersistentNode<Key, Value>* curr = mNode;
+	if(curr->getRight())
+	{
+		descend(curr->getRight(), true);
+		return *this;
+	}
+	mPath.pop_back();
+	while(!mPath.empty() && mPath.back()->getRight() == curr)
+	{
+		curr = mPath.back();
+		mPath.pop_back();
+	}
+	mNode = mPath.empty() ? nullptr : mPath.back();
+	return *this;
+}
+
+/**
+* Advances the const_iterator, returning a copy of its old position.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::const_iterator PersistentAVLTree<Key, Value>::const_iterator::operator++(int)
+{
+	const_iterator old(*this);
+	++(*this);
+	return old;
+}
+
+/**
+* Moves back to the in-order predecessor. The end iterator moves back
+* to the largest item.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::const_iterator& PersistentAVLTree<Key, Value>::const_iterator::operator--()
+{
+	if(mNode == nullptr)
+	{
+		descend(mRoot, false);
+		return *this;
+	}
+	buildPath();
+	const PersistentNode<Key, Value>* curr = mNode;
+	if(curr->getLeft())
+	{
+		descend(curr->getLeft(), false);
+		return *this;
+	}
+	mPath.pop_back();
+	while(!mPath.empty() && mPath.back()->getLeft() == curr)
+	{
+		curr = mPath.back();
+		mPath.pop_back();
+	}
+	mNode = mPath.empty() ? nullptr : mPath.back();
+	return *this;
+}
+
+/**
+* Moves the const_iterator back, returning a copy of its old position.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::const_iterator PersistentAVLTree<Key, Value>::const_iterator::operator--(int)
+{
+	const_iterator old(*this);
+	--(*this);
+	return old;
+}
+
+/**
+* Extends the path from the node down its leftmost or rightmost spine.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::const_iterator::descend(const PersistentNode<Key, Value>* node, bool leftward)
+{
+	while(node)
+	{
+		mPath.push_back(node);
+		mNode = node;
+		node = leftward ? node->getLeft() : node->getRight();
+	}
+}
+
+/**
+* Records the path from the root to the current node, if not done yet,
+* by searching for its key.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::const_iterator::buildPath()
+{
+	if(!mPath.empty())
+	{
+		return;
+	}
+	const PersistentNode<Key, Value>* curr = mRoot;
+	while(curr != mNode)
+	{
+		mPath.push_back(curr);
+		curr = mNode->getKey() < curr->getKey() ? curr->getLeft() : curr->getRight();
+	}
+	mPath.push_back(mNode);
+}
+
+/*
+	-----------------------------------------------------------------
+	End implementations for the PersistentAVLTree::const_iterator class.
+	-----------------------------------------------------------------
+*/
+
+/*
+	------------------------------------------------------
+	Begin implementations for the PersistentAVLTree class.
+	------------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree()
+	: mRoot(nullptr)
+	, mSize(0)
+{
+
+}
+
+/**
+* Copy constructor. The copy shares every node with the original.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree(const PersistentAVLTree<Key, Value>& other)
+	: mRoot(retain(other.mRoot))
+	, mSize(other.mSize)
+{
+
+}
+
+/**
+* Move constructor, leaving the other tree empty.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree(PersistentAVLTree<Key, Value>&& other)
+	: mRoot(other.mRoot)
+	, mSize(other.mSize)
+{
+	other.mRoot = nullptr;
+	other.mSize = 0;
+}
+
+/**
+* Destructor. Frees the nodes no other version shares.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>::~PersistentAVLTree()
+{
+	release(mRoot);
+}
+
+/**
+* Copy assignment, sharing the other tree's nodes.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>& PersistentAVLTree<Key, Value>::operator=(const PersistentAVLTree<Key, Value>& other)
+{
+	NodeType* old = mRoot;
+	mRoot = retain(other.mRoot);
+	mSize = other.mSize;
+	release(old);
+	return *this;
+}
+
+/**
+* Move assignment, leaving the other tree empty.
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value>& PersistentAVLTree<Key, Value>::operator=(PersistentAVLTree<Key, Value>&& other)
+{
+	if(this != &other)
+	{
+		release(mRoot);
+		mRoot = other.mRoot;
+		mSize = other.mSize;
+		other.mRoot = nullptr;
+		other.mSize = 0;
+	}
+	return *this;
+}
+
+/**
+* Returns an immutable view of the tree as it is now in O(1).
+*/
+template<typename Key, typename Value>
+PersistentAVLTree<Key, Value> PersistentAVLTree<Key, Value>::snapshot() const
+{
+	return *this;
+}
+
+/**
+* Inserts a copy of the item, overwriting the value if the key is present.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::insert(const std::pair<Key, Value>& keyValuePair)
+{
+	bool added = false;
+	NodeType* root = insertAt(mRoot, keyValuePair, added);
+	release(mRoot);
+	mRoot = root;
+	mSize += added ? 1 : 0;
+}
+
+/**
+* Inserts the item, moving it into its new node.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::insert(std::pair<Key, Value>&& keyValuePair)
+{
+	bool added = false;
+	NodeType* root = insertAt(mRoot, std::move(keyValuePair), added);
+	release(mRoot);
+	mRoot = root;
+	mSize += added ? 1 : 0;
+}
+
+/**
+* Removes the item with the given key, if any. Nothing is copied when
+* the key is absent.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::remove(const Key& key)
+{
+	if(internalFind(key) == nullptr)
+	{
+		return;
+	}
+	NodeType* root = removeAt(mRoot, key);
+	release(mRoot);
+	mRoot = root;
+	--mSize;
+}
+
+/**
+* Empties this version. Snapshots keep their items.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::clear()
+{
+	release(mRoot);
+	mRoot = nullptr;
+	mSize = 0;
+}
+
+/**
+* Returns the number of items.
+*/
+template<typename Key, typename Value>
+std::size_t PersistentAVLTree<Key, Value>::size() const
+{
+	return mSize;
+}
+
+/**
+* Returns true if the tree holds no items.
+*/
+template<typename Key, typename Value>
+bool PersistentAVLTree<Key, Value>::empty() const
+{
+	return mRoot == nullptr;
+}
+
+/**
+* Checks order, stored heights, AVL balance and the item count.
+*/
+template<typename Key, typename Value>
+TreeStats PersistentAVLTree<Key, Value>::validate() const
+{
+	TreeStats stats = {true, true, true, true, true, true, 0, 0};
+	stats.height = validateNode(mRoot, nullptr, nullptr, stats);
+	stats.countsValid = stats.size == mSize;
+	return stats;
+}
+
+/**
+* Returns an iterator to the smallest item.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::const_iterator PersistentAVLTree<Key, Value>::begin() const
+{
+	const_iterator it(nullptr, mRoot);
+	it.descend(mRoot, true);
+	return it;
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::const_iterator PersistentAVLTree<Key, Value>::end() const
+{
+	return const_iterator(nullptr, mRoot);
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::const_iterator PersistentAVLTree<Key, Value>::find(const Key& key) const
+{
+	return const_iterator(internalFind(key), mRoot);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than the
+* given key, or the end iterator if there is none.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::const_iterator PersistentAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+	// The answer is the last node at which the walk went left.
+	const NodeType* result = nullptr;
+	for(const NodeType* curr = mRoot; curr; )
+	{
+		if(curr->getKey() < key)
+		{
+			curr = curr->getRight();
+
+		} else {
+
+			result = curr;
+			curr = curr->getLeft();
+		}
+	}
+	return const_iterator(result, mRoot);
+}
+
+/**
+* Takes another reference to a node. Accepts null.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::NodeType* PersistentAVLTree<Key, Value>::retain(NodeType* node)
+{
+	if(node)
+	{
+		node->mRefs.fetch_add(1, std::memory_order_relaxed);
+	}
+	return node;
+}
+
+/**
+* Drops a reference to a node, freeing it and dropping its references to
+* its children if it was the last. Accepts null.
+*/
+template<typename Key, typename Value>
+void PersistentAVLTree<Key, Value>::release(NodeType* node)
+{
+	std::vector<NodeType*> pending;
+	while(node || !pending.empty())
+	{
+		if(node == nullptr)
+		{
+			node = pending.back();
+			pending.pop_back();
+		}
+		if(node->mRefs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+		{
+			node = nullptr;
+			continue;
+		}
+		if(node->mRight)
+		{
+			pending.push_back(node->mRight);
+		}
+		NodeType* left = node->mLeft;
+		delete node;
+		node = left;
+	}
+}
+
+/**
+* Returns the height of a subtree, where an empty one has height 0.
+*/
+template<typename Key, typename Value>
+int PersistentAVLTree<Key, Value>::heightOf(const NodeType* node)
+{
+	return node ? node->mHeight : 0;
+}
+
+/**
+* Builds a node for the item over the two subtrees, whose heights differ
+* by at most two, taking over the references to them. If they are out
+* of balance the result is rotated, using new nodes in place of the
+* shared ones a rotation would otherwise have to change.
+*/
+template<typename Key, typename Value>
+template<typename Item>
+typename PersistentAVLTree<Key, Value>::NodeType* PersistentAVLTree<Key, Value>::balance(Item&& item, NodeType* left, NodeType* right)
+{
+	if(heightOf(left) > heightOf(right) + 1)
+	{
+		NodeType* result;
+		if(heightOf(left->mLeft) >= heightOf(left->mRight))
+		{
+			result = new NodeType(left->mItem, retain(left->mLeft),
+				new NodeType(std::forward<Item>(item), retain(left->mRight), right));
+
+		} else {
+
+			NodeType* pivot = left->mRight;
+			result = new NodeType(pivot->mItem,
+				new NodeType(left->mItem, retain(left->mLeft), retain(pivot->mLeft)),
+				new NodeType(std::forward<Item>(item), retain(pivot->mRight), right));
+		}
+		release(left);
+		return result;
+	}
+
+	if(heightOf(right) > heightOf(left) + 1)
+	{
+		NodeType* result;
+		if(heightOf(right->mRight) >= heightOf(right->mLeft))
+		{
+			result = new NodeType(right->mItem,
+				new NodeType(std::forward<Item>(item), left, retain(right->mLeft)), retain(right->mRight));
+
+		} else {
+
+			NodeType* pivot = right->mLeft;
+			result = new NodeType(pivot->mItem,
+				new NodeType(std::forward<Item>(item), left, retain(pivot->mLeft)),
+				new NodeType(right->mItem, retain(pivot->mRight), retain(right->mRight)));
+		}
+		release(right);
+		return result;
+	}
+
+	return new NodeType(std::forward<Item>(item), left, right);
+}
+
+/**
+* Returns a new version of the subtree with the item inserted, sharing
+* every subtree off the search path with the old one.
+*/
+template<typename Key, typename Value>
+template<typename Item>
+typename PersistentAVLTree<Key, Value>::NodeType* PersistentAVLTree<Key, Value>::insertAt(NodeType* node, Item&& item, bool& added)
+{
+	if(node == nullptr)
+	{
+		added = true;
+		return new NodeType(std::forward<Item>(item), nullptr, nullptr);
+	}
+	if(item.first < node->getKey())
+	{
+		return balance(node->mItem, insertAt(node->mLeft, std::forward<Item>(item), added), retain(node->mRight));
+	}
+	if(node->getKey() < item.first)
+	{
+		return balance(node->mItem, retain(node->mLeft), insertAt(node->mRight, std::forward<Item>(item), added));
+	}
+	return new NodeType(std::forward<Item>(item), retain(node->mLeft), retain(node->mRight));
+}
+
+/**
+* Returns a new version of the subtree without the key, which must be
+* present. A node with two children is replaced by its successor.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::NodeType* PersistentAVLTree<Key, Value>::removeAt(NodeType* node, const Key& key)
+{
+	if(key < node->getKey())
+	{
+		return balance(node->mItem, removeAt(node->mLeft, key), retain(node->mRight));
+	}
+	if(node->getKey() < key)
+	{
+		return balance(node->mItem, retain(node->mLeft), removeAt(node->mRight, key));
+	}
+	if(node->mLeft == nullptr || node->mRight == nullptr)
+	{
+		return retain(node->mLeft ? node->mLeft : node->mRight);
+	}
+	const std::pair<Key, Value>* successor = nullptr;
+	NodeType* right = removeMin(node->mRight, successor);
+	return balance(*successor, retain(node->mLeft), right);
+}
+
+/**
+* Returns a new version of the subtree without its smallest item, and
+* points minItem at that item in the old version.
+*/
+template<typename Key, typename Value>
+typename PersistentAVLTree<Key, Value>::NodeType* PersistentAVLTree<Key, Value>::removeMin(NodeType* node, const std::pair<Key, Value>*& minItem)
+{
+	if(node->mLeft == nullptr)
+	{
+		minItem = &node->mItem;
+		return retain(node->mRight);
+	}
+	return balance(node->mItem, removeMin(node->mLeft, minItem), retain(node->mRight));
+}
+
+/**
+* Returns the node with the given key, or null.
+*/
+template<typename Key, typename Value>
+const typename PersistentAVLTree<Key, Value>::NodeType* PersistentAVLTree<Key, Value>::internalFind(const Key& key) const
+{
+	const NodeType* curr = mRoot;
+	while(curr)
+	{
+		if(key < curr->getKey())
+		{
+			curr = curr->getLeft();
+
+		} else if(curr->getKey() < key) {
+
+			curr = curr->getRight();
+
+		} else {
+
+			return curr;
+		}
+	}
+	return nullptr;
+}
+
+/**
+* Checks a subtree whose keys must lie in (low, high), where a null
+* bound is open, and returns its measured height.
+*/
+template<typename Key, typename Value>
+int PersistentAVLTree<Key, Value>::validateNode(const NodeType* node, const Key* low, const Key* high, TreeStats& stats) const
+{
+	if(node == nullptr)
+	{
+		return 0;
+	}
+	if((low && !(*low < node->getKey())) || (high && !(node->getKey() < *high)))
+	{
+		stats.ordered = false;
+	}
+	int left = validateNode(node->mLeft, low, &node->getKey(), stats);
+	int right = validateNode(node->mRight, &node->getKey(), high, stats);
+	int height = 1 + std::max(left, right);
+	if(left - right > 1 || right - left > 1)
+	{
+		stats.balanced = false;
+	}
+	if(node->mHeight != height)
+	{
+		stats.heightsValid = false;
+	}
+	++stats.size;
+	return height;
+}
+
+/*
+	----------------------------------------------------
+	End implementations for the PersistentAVLTree class.
+	----------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,185 @@
+#include "persistentavl.h"
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+	Tests for PersistentAVLTree: random inserts, overwrites and removes
+	checked against std::map, snapshots that must keep their items however
+	the tree changes afterwards, and snapshots handed to other threads
+	that change and drop their own versions while the original is written.
+*/
+
+static int failures = 0;
+
+static void check(bool ok, const char* what)
+{
+	if(!ok)
+	{
+		std::printf("FAILED: %s\n", what);
+		++failures;
+	}
+}
+
+/**
+* Returns true if the tree holds exactly the items of the map, is a valid
+* AVL tree and agrees with the map on every lookup and lower bound in
+* [0, limit).
+*/
+template<typename Key>
+static bool sameItems(const PersistentAVLTree<Key, int>& tree, const std::map<Key, int>& expected)
+{
+	TreeStats stats = tree.validate();
+	if(!stats.valid() || !stats.balanced || tree.size() != expected.size() || tree.empty() != expected.empty())
+	{
+		return false;
+	}
+	typename PersistentAVLTree<Key, int>::const_iterator it = tree.begin();
+	for(typename std::map<Key, int>::const_iterator e = expected.begin(); e != expected.end(); ++e, ++it)
+	{
+		if(it == tree.end() || it->first != e->first || it->second != e->second
+			|| tree.find(e->first) != it || tree.lower_bound(e->first) != it)
+		{
+			return false;
+		}
+	}
+	return it == tree.end();
+}
+
+/**
+* Mutates one tree at random and takes a snapshot, together with a copy
+* of the map, every so often. Every snapshot must still match its map
+* at the end.
+*/
+static void testSnapshots()
+{
+	PersistentAVLTree<int, int> tree;
+	std::map<int, int> expected;
+	std::vector<PersistentAVLTree<int, int> > snapshots;
+	std::vector<std::map<int, int> > snapshotItems;
+	std::mt19937 rng(9);
+	bool ok = true;
+
+	for(int i = 0; i < 40000 && ok; ++i)
+	{
+		int key = rng() % 3000;
+		if(rng() % 3)
+		{
+			tree.insert(std::make_pair(key, i));
+			expected[key] = i;
+
+		} else {
+
+			tree.remove(key);
+			expected.erase(key);
+		}
+
+		int probe = rng() % 3000;
+		ok = (tree.find(probe) == tree.end()) == (expected.find(probe) == expected.end());
+
+		if(i % 2000 == 0)
+		{
+			ok = ok && sameItems(tree, expected);
+			snapshots.push_back(tree.snapshot());
+			snapshotItems.push_back(expected);
+		}
+	}
+	check(ok, "against std::map");
+
+	for(std::size_t i = 0; i < snapshots.size(); ++i)
+	{
+		ok = ok && sameItems(snapshots[i], snapshotItems[i]);
+	}
+	check(ok, "snapshots unchanged");
+
+	PersistentAVLTree<int, int> copy(tree);
+	PersistentAVLTree<int, int> moved(std::move(copy));
+	tree.clear();
+	check(sameItems(moved, expected) && copy.empty() && tree.empty(), "copy, move and clear");
+}
+
+/**
+* Hands a snapshot to each of several threads, which write to and drop
+* their own versions while this thread keeps writing the original. The
+* shared nodes' reference counts must hold up, and every version must
+* end up with exactly its own items.
+*/
+static void testThreads()
+{
+	PersistentAVLTree<std::string, int> tree;
+	std::map<std::string, int> expected;
+	for(int i = 0; i < 5000; ++i)
+	{
+		tree.insert(std::make_pair(std::to_string(i), i));
+		expected[std::to_string(i)] = i;
+	}
+
+	const int kThreads = 4;
+	std::vector<char> results(kThreads, 0);
+	std::vector<std::thread> threads;
+	for(int t = 0; t < kThreads; ++t)
+	{
+		PersistentAVLTree<std::string, int> mine = tree.snapshot();
+		threads.push_back(std::thread([t, mine, expected, &results]() mutable {
+			std::mt19937 rng(t + 1);
+			for(int i = 0; i < 5000; ++i)
+			{
+				std::string key = std::to_string(rng() % 6000);
+				if(rng() % 2)
+				{
+					mine.insert(std::make_pair(key, -t));
+					expected[key] = -t;
+
+				} else {
+
+					mine.remove(key);
+					expected.erase(key);
+				}
+				if(i % 500 == 0)
+				{
+					PersistentAVLTree<std::string, int> dropped = mine.snapshot();
+				}
+			}
+			results[t] = sameItems(mine, expected);
+		}));
+	}
+
+	std::map<std::string, int> original = expected;
+	for(int i = 0; i < 5000; ++i)
+	{
+		std::string key = std::to_string(i);
+		if(i % 2)
+		{
+			tree.remove(key);
+			original.erase(key);
+
+		} else {
+
+			tree.insert(std::make_pair(key, i * 2));
+			original[key] = i * 2;
+		}
+	}
+
+	bool ok = true;
+	for(int t = 0; t < kThreads; ++t)
+	{
+		threads[t].join();
+		ok = ok && results[t];
+	}
+	check(ok && sameItems(tree, original), "snapshots across threads");
+}
+
+int main()
+{
+	testSnapshots();
+	testThreads();
+
+	if(failures == 0)
+	{
+		std::printf("persistentavl_test: all passed\n");
+	}
+	return failures == 0 ? 0 : 1;
+}
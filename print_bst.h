@@ -0,0 +1,61 @@
+#ifndef PRINT_BST_H
+#define PRINT_BST_H
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+* Prints up to five levels of the subtree rooted at r to std::cout, one
+* line per level. Each level splits the width of the line evenly between
+* its slots and centers each key in its slot, so a child sits below its
+* parent; a slot whose node is missing stays blank. Keys are written with
+* operator<<, so this only compiles for keys that have one.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::printRoot(Node<Key, Value>* r) const
+{
+	const int kLevels = 5;
+	const int kSlotWidth = 6;
+	const std::size_t width = kSlotWidth << (kLevels - 1);
+
+	if(r == nullptr)
+	{
+		std::cout << "(empty)" << std::endl;
+		return;
+	}
+
+	std::vector<Node<Key, Value>*> level(1, r);
+	for(int depth = 0; depth < kLevels; ++depth)
+	{
+		std::size_t slot = width / level.size();
+		std::string line;
+		bool any = false;
+		std::vector<Node<Key, Value>*> next;
+		for(std::size_t i = 0; i < level.size(); ++i)
+		{
+			std::string text;
+			if(level[i] != nullptr)
+			{
+				std::ostringstream key;
+				key << level[i]->getKey();
+				text = key.str().substr(0, slot - 1);
+				any = true;
+			}
+			std::size_t before = (slot - text.size()) / 2;
+			line += std::string(before, ' ') + text + std::string(slot - before - text.size(), ' ');
+			next.push_back(level[i] ? level[i]->getLeft() : nullptr);
+			next.push_back(level[i] ? level[i]->getRight() : nullptr);
+		}
+		if(!any)
+		{
+			break;
+		}
+		line.erase(line.find_last_not_of(' ') + 1);
+		std::cout << line << std::endl;
+		level.swap(next);
+	}
+}
+
+#endif
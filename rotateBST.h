@@ -2,141 +2,600 @@
 #define ROTATEBST_H
 
 #include "bst.h"
-#include <set>
+#include <cmath>
 
 template<typename Key, typename Value>
 class rotateBST : public BinarySearchTree<Key, Value> { 
 public:
 	rotateBST();
+	explicit rotateBST(const std::shared_ptr<NodeAllocator>& allocator);
+	rotateBST(const rotateBST& other) = default;
+	rotateBST(rotateBST&& other) = default;
 	virtual ~rotateBST();
+	rotateBST& operator=(const rotateBST& other) = default;
+	rotateBST& operator=(rotateBST&& other) = default;
 	bool sameKeys(const rotateBST& t2) const;
-	void transform(rotateBST& t2) const;
+	bool transform(rotateBST& t2, std::size_t& rotations) const;
+	virtual void rebalance();
+	void setRebalanceFactor(double factor);
 protected:
-	void leftRotate(Node<Key, Value>* r);
-	void rightRotate(Node<Key, Value>* r);
+	template<typename NodeType>
+	void leftRotate(NodeType* r);
+	template<typename NodeType>
+	void rightRotate(NodeType* r);
+	template<typename NodeType>
+	void leftRotate(NodeType* r, Node<Key,Value>*& top);
+	template<typename NodeType>
+	void rightRotate(NodeType* r, Node<Key,Value>*& top);
+	template<typename NodeType>
+	void rebalanceNodes();
+	virtual Node<Key, Value>* attachItem(Node<Key, Value>* parent, std::pair<Key, Value>&& item) override;
 private:
-	void linkedList(Node<Key,Value>* root, rotateBST& t2) const;
-	void transformHelper(Node<Key,Value>* root, Node<Key,Value>* t2_root,
-						rotateBST& t2) const;
-	Node<Key, Value>* smallestSubtree(Node<Key,Value>* r) const;
+	/**
+	* The shape of a tree as the in-order positions of each node's
+	* children and parent, where position 0 means none.
+	*/
+	struct Shape
+	{
+		std::vector<int> left;
+		std::vector<int> right;
+		std::vector<int> parent;
+		int root;
+	};
+
+	static void shapeOf(Node<Key,Value>* root, Shape& shape, std::vector<Node<Key,Value>*>* nodes);
+	static std::vector<int> fanDegrees(const Shape& shape);
+	static void toFan(Shape& shape, int v, std::vector<std::pair<int, int> >& steps);
+	static void rotateUp(Shape& shape, int child);
+	void rotateUp(Node<Key,Value>* child);
+	template<typename NodeType>
+	std::size_t rebuild(Node<Key,Value>*& top);
+	template<typename NodeType>
+	void compress(std::size_t count, Node<Key,Value>*& top);
+	static std::size_t countNodes(Node<Key,Value>* root);
+	void rebuildScapegoat(Node<Key,Value>* leaf);
+
+	// Auto-rebalancing is off while the factor is 0.
+	double mRebalanceFactor;
 };
 
 /**
 * Calls the constructor for a BST.
 */
 template<typename Key, typename Value>
-rotateBST<Key,Value>::rotateBST():BinarySearchTree<Key,Value>() { }
+rotateBST<Key,Value>::rotateBST():BinarySearchTree<Key,Value>(), mRebalanceFactor(0) { }
+
+/**
+* Calls the constructor for a BST that draws nodes from the given allocator.
+*/
+template<typename Key, typename Value>
+rotateBST<Key,Value>::rotateBST(const std::shared_ptr<NodeAllocator>& allocator)
+	:BinarySearchTree<Key,Value>(allocator), mRebalanceFactor(0) { }
 
 template<typename Key, typename Value>
 rotateBST<Key,Value>::~rotateBST() { }
 
 /**
-* Iterates through both BST's and inserts their keys into sets,
-* returns true if they equate.
+* Walks both trees in key order side by side and returns true if they
+* hold the same keys, stopping at the first key that differs. Trees of
+* different sizes are told apart without a walk. Nothing is allocated.
 */
 template<typename Key, typename Value>
 bool rotateBST<Key,Value>::sameKeys(const rotateBST& t2) const 
 {
-	std::set<Key> one;
-	std::set<Key> two;
+	if(this->size() != t2.size()) {
+		return false;
+	}
+	typename rotateBST<Key, Value>::const_iterator it = this->cbegin();
+	typename rotateBST<Key, Value>::const_iterator jt = t2.cbegin();
+
+	for(; it != this->cend() && jt != t2.cend(); ++it, ++jt) {
+		if(it->first < jt->first || jt->first < it->first) {
+			return false;
+		}
+	}
+	return it == this->cend() && jt == t2.cend();
+}
+
+/**
+* Rotates t2 into the shape of this tree and sets rotations to the number
+* used. Returns false, leaving t2 alone and rotations at 0, if the trees
+* hold different keys, since no rotations can turn one into the other;
+* a count of 0 on its own can also mean t2 already had the shape.
+*
+* Shapes of n nodes correspond to triangulations of a polygon with n + 2
+* corners, and a rotation to flipping one diagonal. For every corner v
+* there is a canonical shape whose diagonals all meet at v (see toFan()),
+* and a shape with d diagonals at v reaches it in exactly n - 1 - d
+* rotations, each adding one. Both trees are taken to the canonical shape
+* for the corner where they have the most diagonals between them, and t2
+* then retraces the steps of this tree backwards. Since the two trees
+* have 4n - 4 diagonals at n + 2 corners between them, some corner has
+* at least 4 once n >= 11, so this takes at most 2n - 6 rotations.
+* This tree is only simulated, on arrays of in-order positions.
+*/
+template<typename Key, typename Value>
+bool rotateBST<Key,Value>::transform(rotateBST& t2, std::size_t& rotations) const 
+{
+	rotations = 0;
+	if(!sameKeys(t2)) return false;
+
+	Shape mine;
+	Shape theirs;
+	std::vector<Node<Key,Value>*> nodes;
+	shapeOf(this->mRoot, mine, nullptr);
+	shapeOf(t2.mRoot, theirs, &nodes);
+
+	std::vector<int> mineDegree = fanDegrees(mine);
+	std::vector<int> theirDegree = fanDegrees(theirs);
+	int corner = 0;
+	for(int v = 1; v < static_cast<int>(mineDegree.size()); ++v) {
+		if(mineDegree[v] + theirDegree[v] > mineDegree[corner] + theirDegree[corner]) {
+			corner = v;
+		}
+	}
+
+	// Each step records the node that moved up and the one it moved above.
+	std::vector<std::pair<int, int> > mineSteps;
+	std::vector<std::pair<int, int> > theirSteps;
+	toFan(mine, corner, mineSteps);
+	toFan(theirs, corner, theirSteps);
 
-	typename rotateBST<Key, Value>::iterator it(this->getSmallestNode());
-	typename rotateBST<Key, Value>::iterator end(nullptr);
+	for(std::size_t i = 0; i < theirSteps.size(); ++i) {
+		t2.rotateUp(nodes[theirSteps[i].first]);
+	}
+	for(std::size_t i = mineSteps.size(); i-- > 0; ) {
+		t2.rotateUp(nodes[mineSteps[i].second]);
+	}
+	rotations = mineSteps.size() + theirSteps.size();
+	return true;
+}
+
+/**
+* Records the shape of a tree as arrays indexed by in-order position,
+* counted from 1 so that 0 can stand for no node. The walk notes each
+* node's depth, and the shape is rebuilt from the depths with a stack:
+* a subtree's root is the shallowest node in its range of positions.
+* The nodes themselves are listed by position too if asked for.
+*/
+template<typename Key, typename Value>
+void rotateBST<Key,Value>::shapeOf(Node<Key,Value>* root, Shape& shape, 
+	std::vector<Node<Key,Value>*>* nodes)
+{
+	std::vector<int> depth(1, 0);
+	if(nodes) {
+		nodes->assign(1, nullptr);
+	}
 
-	for(; it != end; ++it) {
-		one.insert(it->first);
+	Node<Key,Value>* curr = root;
+	int level = 0;
+	while(curr && curr->getLeft()) {
+		curr = curr->getLeft();
+		++level;
 	}
+	while(curr) {
+		depth.push_back(level);
+		if(nodes) {
+			nodes->push_back(curr);
+		}
 
-	typename rotateBST<Key, Value>::iterator jt(t2.getSmallestNode());
-	
-	for(; jt != end; ++jt) {
-		two.insert(jt->first);
+		if(curr->getRight()) {
+			curr = curr->getRight();
+			++level;
+			while(curr->getLeft()) {
+				curr = curr->getLeft();
+				++level;
+			}
+		} else {
+			Node<Key,Value>* child;
+			do {
+				child = curr;
+				curr = curr->getParent();
+				--level;
+			} while(curr && curr->getRight() == child);
+		}
 	}
 
-	return one == two;
+	std::size_t count = depth.size();
+	shape.left.assign(count, 0);
+	shape.right.assign(count, 0);
+	shape.parent.assign(count, 0);
+	std::vector<int> spine;
+	for(int k = 1; k < static_cast<int>(count); ++k) {
+		int below = 0;
+		while(!spine.empty() && depth[spine.back()] > depth[k]) {
+			below = spine.back();
+			spine.pop_back();
+		}
+		shape.left[k] = below;
+		if(below) {
+			shape.parent[below] = k;
+		}
+		if(!spine.empty()) {
+			shape.right[spine.back()] = k;
+			shape.parent[k] = spine.back();
+		}
+		spine.push_back(k);
+	}
+	shape.root = spine.empty() ? 0 : spine.front();
 }
 
 /**
-* Calls the helper function that does the transformation. 
+* Counts the diagonals at each corner of the polygon for a shape. Corner v
+* for 1 <= v <= n sits between positions v - 1 and v + 1, and its diagonals
+* are the subtrees ending at v - 1 or starting at v + 1: the right spine
+* of the left subtree of v and the left spine of its right subtree. The
+* corners 0 and n + 1 have the spines of the whole tree, less the root.
 */
 template<typename Key, typename Value>
-void rotateBST<Key,Value>::transform(rotateBST& t2) const 
+std::vector<int> rotateBST<Key,Value>::fanDegrees(const Shape& shape)
 {
-	if(!sameKeys(t2)) return;
-	transformHelper(this->mRoot, t2.mRoot, t2);
+	int n = static_cast<int>(shape.left.size()) - 1;
+	std::vector<int> leftSpine(n + 1, 0);
+	std::vector<int> rightSpine(n + 1, 0);
+	for(int k = 1; k <= n; ++k) {
+		leftSpine[k] = 1 + leftSpine[shape.left[k]];
+	}
+	for(int k = n; k >= 1; --k) {
+		rightSpine[k] = 1 + rightSpine[shape.right[k]];
+	}
+
+	std::vector<int> degree(n + 2, 0);
+	if(n == 0) {
+		return degree;
+	}
+	for(int k = 1; k <= n; ++k) {
+		degree[k] = rightSpine[shape.left[k]] + leftSpine[shape.right[k]];
+	}
+	degree[0] = leftSpine[shape.root] - 1;
+	degree[n + 1] = rightSpine[shape.root] - 1;
+	return degree;
 }
 
-/** 
-* Performs the right rotations that create a linked list 
-* we can then shape. 
+/**
+* Rotates a shape into the one whose diagonals all meet at corner v: node v
+* at the root, the nodes before it in a chain of right children and those
+* after it in a chain of left children. Corner 0 is all left children and
+* corner n + 1 all right children. Node v is rotated up first and the two
+* sides are then straightened out from the top, every rotation adding a
+* diagonal at v and none taking one away.
 */
 template<typename Key, typename Value>
-void rotateBST<Key,Value>::linkedList(Node<Key,Value>* t2_root, rotateBST& t2) const 
+void rotateBST<Key,Value>::toFan(Shape& shape, int v, std::vector<std::pair<int, int> >& steps)
 {
-	if(t2_root == nullptr) {
-		return;
+	int n = static_cast<int>(shape.left.size()) - 1;
+	bool inner = v >= 1 && v <= n;
+
+	while(inner && shape.parent[v]) {
+		steps.push_back(std::make_pair(v, shape.parent[v]));
+		rotateUp(shape, v);
 	}
 
-	while(t2_root->getLeft()) 
-	{
-		t2.rightRotate(t2_root);
-		t2_root = t2_root->getParent();
+	int curr = inner ? shape.left[v] : v == n + 1 ? shape.root : 0;
+	while(curr) {
+		int child = shape.left[curr];
+		if(child) {
+			steps.push_back(std::make_pair(child, curr));
+			rotateUp(shape, child);
+			curr = child;
+		} else {
+			curr = shape.right[curr];
+		}
+	}
+
+	curr = inner ? shape.right[v] : v == 0 ? shape.root : 0;
+	while(curr) {
+		int child = shape.right[curr];
+		if(child) {
+			steps.push_back(std::make_pair(child, curr));
+			rotateUp(shape, child);
+			curr = child;
+		} else {
+			curr = shape.left[curr];
+		}
 	}
-	linkedList(t2_root->getRight(), t2);
 }
 
-/** 
-* Calls left left rotate recursively on each child of each node 
-* eventually equating the values. 
+/**
+* Rotates a node of a shape above its parent.
 */
 template<typename Key, typename Value>
-void rotateBST<Key,Value>::transformHelper(Node<Key,Value>* root, 
-	Node<Key,Value>* t2_root, rotateBST& t2) const {
+void rotateBST<Key,Value>::rotateUp(Shape& shape, int child)
+{
+	int parent = shape.parent[child];
+	int grandparent = shape.parent[parent];
+	if(shape.left[parent] == child) {
+		shape.left[parent] = shape.right[child];
+		shape.parent[shape.right[child]] = parent;
+		shape.right[child] = parent;
+	} else {
+		shape.right[parent] = shape.left[child];
+		shape.parent[shape.left[child]] = parent;
+		shape.left[child] = parent;
+	}
+	shape.parent[parent] = child;
+	shape.parent[child] = grandparent;
+	shape.parent[0] = 0;
+
+	if(grandparent == 0) {
+		shape.root = child;
+	} else if(shape.left[grandparent] == parent) {
+		shape.left[grandparent] = child;
+	} else {
+		shape.right[grandparent] = child;
+	}
+}
 
-	if(t2_root == nullptr && root == nullptr) {
-		return;
+/**
+* Rotates a node of the tree above its parent.
+*/
+template<typename Key, typename Value>
+void rotateBST<Key,Value>::rotateUp(Node<Key,Value>* child)
+{
+	Node<Key,Value>* parent = child->getParent();
+	if(parent->getLeft() == child) {
+		rightRotate(parent);
+	} else {
+		leftRotate(parent);
 	}
+}
 
-	Node<Key,Value>* subRoot = smallestSubtree(t2_root);
-	linkedList(t2_root, t2);
-	t2_root = subRoot;
+/**
+* Rebuilds the tree into a perfectly balanced shape in place with the
+* Day-Stout-Warren algorithm, in O(n) time and O(1) extra space.
+*/
+template<typename Key, typename Value>
+void rotateBST<Key,Value>::rebalance()
+{
+	rebalanceNodes<Node<Key, Value> >();
+}
 
-	while(t2_root->getKey() != root->getKey()) 
-	{
-		t2.leftRotate(t2_root);
-		if(t2_root->getParent()) {
-			t2_root = t2_root->getParent();
+/**
+* Turns on rebalancing whenever an insert leaves a leaf deeper than the
+* factor times log2 of the number of items. The tree is then mended as a
+* scapegoat tree would be: only the lowest subtree above the leaf whose
+* larger side outweighs the factor's balance is rebuilt, which takes time
+* in its size. A rebuilt subtree needs a constant fraction of its size in
+* fresh inserts before it can be picked again, so the rebuilding costs
+* amortized O(log n) per insert, and O(n log n) over n inserts however
+* they are ordered. Factors near 1 would rebuild nearly every insert; 2 or
+* 3 leave room for ordinary unevenness. A factor of 0 turns it off again.
+*/
+template<typename Key, typename Value>
+void rotateBST<Key,Value>::setRebalanceFactor(double factor)
+{
+	mRebalanceFactor = factor;
+}
+
+/**
+* Hangs the new leaf as the plain tree does and rebuilds a subtree above
+* it if the leaf is deeper than the auto-rebalance factor allows. The
+* rebuilding keeps the tree within that depth, so finding the leaf's depth
+* costs no more than a logarithmic walk.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* rotateBST<Key,Value>::attachItem(Node<Key, Value>* parent, std::pair<Key, Value>&& item)
+{
+	Node<Key, Value>* leaf = BinarySearchTree<Key, Value>::attachItem(parent, std::move(item));
+	if(mRebalanceFactor <= 0) {
+		return leaf;
+	}
+
+	std::size_t depth = 1;
+	for(Node<Key, Value>* curr = parent; curr; curr = curr->getParent()) {
+		++depth;
+	}
+	if(depth > mRebalanceFactor * std::log2(static_cast<double>(this->size()) + 1) + 1) {
+		rebuildScapegoat(leaf);
+	}
+	return leaf;
+}
+
+/**
+* Walks up from a leaf that is too deep to the first node whose child on
+* the leaf's side holds more than 2^(-1/factor) of its items, and rebuilds
+* the subtree there. Were every node on the way within that share, the
+* leaf could be no deeper than factor * log2(n) + 1, so such a node is
+* always found; the root stands in should rounding say otherwise. Sizes
+* are found by counting the other side at each step, which costs no more
+* than the rebuild.
+*/
+template<typename Key, typename Value>
+void rotateBST<Key,Value>::rebuildScapegoat(Node<Key,Value>* leaf)
+{
+	double share = std::pow(2.0, -1.0 / mRebalanceFactor);
+	std::size_t childSize = 1;
+	Node<Key,Value>* child = leaf;
+	Node<Key,Value>* scapegoat = this->mRoot;
+	for(Node<Key,Value>* curr = leaf->getParent(); curr; curr = curr->getParent()) {
+		Node<Key,Value>* other = curr->getLeft() == child ? curr->getRight() : curr->getLeft();
+		std::size_t size = childSize + countNodes(other) + 1;
+		if(childSize > share * size) {
+			scapegoat = curr;
+			break;
+		}
+		childSize = size;
+		child = curr;
+	}
+
+	Node<Key,Value>* above = scapegoat->getParent();
+	if(!above) {
+		rebuild<Node<Key,Value> >(this->mRoot);
+		return;
+	}
+	bool onLeft = above->getLeft() == scapegoat;
+	scapegoat->setParent(nullptr);
+	Node<Key,Value>* top = scapegoat;
+	rebuild<Node<Key,Value> >(top);
+	top->setParent(above);
+	if(onLeft) {
+		above->setLeft(top);
+	} else {
+		above->setRight(top);
+	}
+}
+
+/**
+* Counts the nodes of a subtree with a walk that follows parent links
+* back up, so it needs no stack.
+*/
+template<typename Key, typename Value>
+std::size_t rotateBST<Key,Value>::countNodes(Node<Key,Value>* root)
+{
+	std::size_t count = 0;
+	Node<Key,Value>* prev = root ? root->getParent() : nullptr;
+	Node<Key,Value>* curr = root;
+	while(curr) {
+		Node<Key,Value>* next;
+		if(prev == curr->getParent()) {
+			++count;
+			next = curr->getLeft() ? curr->getLeft() : curr->getRight() ? curr->getRight() : curr->getParent();
+		} else if(prev == curr->getLeft() && curr->getRight()) {
+			next = curr->getRight();
 		} else {
+			next = curr->getParent();
+		}
+		if(curr == root && next == root->getParent()) {
 			break;
 		}
+		prev = curr;
+		curr = next;
 	}
-	transformHelper(root->getRight(), t2_root->getRight(), t2);
-	transformHelper(root->getLeft(), t2_root->getLeft(), t2);
+	return count;
 }
 
 /**
-* Function that finds the smallest value in a given subtree.
+* Runs Day-Stout-Warren on the whole tree with rotations on the given
+* node type, so nodes that keep their subtree size have it refreshed as
+* they move. Heights are stored afresh at the end.
 */
 template<typename Key, typename Value>
-Node<Key, Value>* rotateBST<Key,Value>::smallestSubtree(Node<Key,Value>* r) const 
+template<typename NodeType>
+void rotateBST<Key,Value>::rebalanceNodes()
 {
-	while(r->getLeft()) {
-		r = r->getLeft();
+	this->mSize = rebuild<NodeType>(this->mRoot);
+
+	// Post-order walk with a stack of finished subtree heights, which
+	// stays as short as the now logarithmic height.
+	if(std::is_same<NodeType, Node<Key, Value> >::value || this->mRoot == nullptr) {
+		return;
 	}
-	return r;
+	std::vector<int> heights;
+	NodeType* prev = nullptr;
+	NodeType* curr = static_cast<NodeType*>(this->mRoot);
+	while(curr) {
+		if(prev == curr->getParent() && curr->getLeft()) {
+			prev = curr;
+			curr = curr->getLeft();
+		} else if(prev != curr->getRight() && curr->getRight()) {
+			prev = curr;
+			curr = curr->getRight();
+		} else {
+			int right = curr->getRight() ? heights.back() : 0;
+			if(curr->getRight()) {
+				heights.pop_back();
+			}
+			int left = curr->getLeft() ? heights.back() : 0;
+			if(curr->getLeft()) {
+				heights.pop_back();
+			}
+			heights.push_back(1 + std::max(left, right));
+			storeHeight(curr, heights.back());
+			prev = curr;
+			curr = curr->getParent();
+		}
+	}
+}
+
+/**
+* Rebuilds the subtree whose root is kept in top, which has no parent,
+* into a perfectly balanced shape and returns its number of nodes. First
+* every left child is rotated up until the subtree is one chain of right
+* children, counting the nodes. Then rounds of left rotations at every
+* other node of the chain fold it in half, after a first round that puts
+* the nodes beyond the largest complete tree on the bottom level.
+*/
+template<typename Key, typename Value>
+template<typename NodeType>
+std::size_t rotateBST<Key,Value>::rebuild(Node<Key,Value>*& top)
+{
+	std::size_t count = 0;
+	NodeType* curr = static_cast<NodeType*>(top);
+	while(curr) {
+		if(curr->getLeft()) {
+			NodeType* child = curr->getLeft();
+			rightRotate(curr, top);
+			curr = child;
+		} else {
+			++count;
+			curr = curr->getRight();
+		}
+	}
+
+	std::size_t complete = 0;
+	while(2 * complete + 1 <= count) {
+		complete = 2 * complete + 1;
+	}
+	compress<NodeType>(count - complete, top);
+	for(std::size_t size = complete; size > 1; ) {
+		size /= 2;
+		compress<NodeType>(size, top);
+	}
+	return count;
 }
 
 /**
-* Performs a left rotate on a given node.
+* Left-rotates the first count nodes at odd positions down the right
+* chain from top, lifting the node after each one above it.
 */
 template<typename Key, typename Value>
-void rotateBST<Key,Value>::leftRotate(Node<Key,Value>* r) 
+template<typename NodeType>
+void rotateBST<Key,Value>::compress(std::size_t count, Node<Key,Value>*& top)
+{
+	NodeType* curr = static_cast<NodeType*>(top);
+	for(std::size_t i = 0; i < count; ++i) {
+		leftRotate(curr, top);
+		curr = curr->getParent()->getRight();
+	}
+}
+
+/**
+* Performs a left rotate on a given node. Nodes that keep their subtree
+* size have it refreshed for the two nodes that moved.
+*/
+template<typename Key, typename Value>
+template<typename NodeType>
+void rotateBST<Key,Value>::leftRotate(NodeType* r) 
+{
+	leftRotate(r, this->mRoot);
+}
+
+/**
+* Performs a right rotate on a given node. Nodes that keep their subtree
+* size have it refreshed for the two nodes that moved.
+*/
+template<typename Key, typename Value>
+template<typename NodeType>
+void rotateBST<Key,Value>::rightRotate(NodeType* r) 
+{
+	rightRotate(r, this->mRoot);
+}
+
+/**
+* Performs a left rotate on a node of a subtree that may be detached from
+* the tree, whose root is kept in top instead of mRoot. Rotations on
+* disjoint detached subtrees touch no shared state, so they may run on
+* different threads.
+*/
+template<typename Key, typename Value>
+template<typename NodeType>
+void rotateBST<Key,Value>::leftRotate(NodeType* r, Node<Key,Value>*& top) 
 {
 	if(!r->getRight()) {
 		return;
 	}
 
-	Node<Key, Value>* new_parent = r->getRight();
+	NodeType* new_parent = r->getRight();
 	r->setRight(new_parent->getLeft());
 
 	if(new_parent->getLeft()) {
@@ -146,7 +605,7 @@ void rotateBST<Key,Value>::leftRotate(Node<Key,Value>* r)
 	new_parent->setParent(r->getParent());
 	if(!r->getParent()) {
 
-		this->mRoot = new_parent;
+		top = new_parent;
 
 	} else if(r == r->getParent()->getLeft()) {
 
@@ -160,19 +619,23 @@ void rotateBST<Key,Value>::leftRotate(Node<Key,Value>* r)
 
 	new_parent->setLeft(r);
 	r->setParent(new_parent);
+
+	updateCount(r);
+	updateCount(new_parent);
 }
 
 /**
-* Performs a right rotate on a given node.
+* Performs a right rotate on a node of a subtree whose root is kept in top.
 */
 template<typename Key, typename Value>
-void rotateBST<Key,Value>::rightRotate(Node<Key,Value>* r) 
+template<typename NodeType>
+void rotateBST<Key,Value>::rightRotate(NodeType* r, Node<Key,Value>*& top) 
 {
 	if(!r->getLeft()) {
 		return;
 	} 
  
-	Node<Key, Value>* new_parent = r->getLeft();
+	NodeType* new_parent = r->getLeft();
 	r->setLeft(new_parent->getRight());
 
 	if(new_parent->getRight()) {
@@ -182,7 +645,7 @@ void rotateBST<Key,Value>::rightRotate(Node<Key,Value>* r)
 	new_parent->setParent(r->getParent());
 	if(!r->getParent()) {
 
-		this->mRoot = new_parent;
+		top = new_parent;
 
 	} else if(r == r->getParent()->getLeft()) {
 
@@ -196,5 +659,8 @@ void rotateBST<Key,Value>::rightRotate(Node<Key,Value>* r)
 
 	new_parent->setRight(r);
 	r->setParent(new_parent);
+
+	updateCount(r);
+	updateCount(new_parent);
 }
 #endif 
\ No newline at end of file
@@ -0,0 +1,319 @@
+#ifndef SIMDSEARCH_H
+#define SIMDSEARCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SIMDSEARCH_X86 1
+#include <immintrin.h>
+#else
+#define SIMDSEARCH_X86 0
+#endif
+
+/*
+	Searching the sorted key array of a wide tree node.
+
+	For 32 and 64 bit integers, floats and doubles, the keys are compared
+	against the search key a whole vector at a time and the comparison
+	mask gives the number of smaller keys directly, instead of branching
+	on one < per step of a binary search. The kernels are compiled for
+	AVX2 and SSE4.2 and picked at runtime from what the CPU reports, so
+	the binary runs everywhere; every other key type, and CPUs with
+	neither extension, use std::lower_bound / std::upper_bound.
+*/
+
+enum SimdLevel
+{
+	kSimdNone,
+	kSimdSse42,
+	kSimdAvx2
+};
+
+/**
+* Asks the CPU which of the vector extensions used here it supports.
+*/
+inline SimdLevel detectSimdLevel()
+{
+#if SIMDSEARCH_X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+	{
+		return kSimdAvx2;
+	}
+	if(__builtin_cpu_supports("sse4.2"))
+	{
+		return kSimdSse42;
+	}
+#endif
+	return kSimdNone;
+}
+
+/**
+* The vector extension node searches use. It starts out as the best one
+* the CPU supports and may be lowered, e.g. to benchmark the scalar path.
+*/
+inline SimdLevel& simdLevel()
+{
+	static SimdLevel level = detectSimdLevel();
+	return level;
+}
+
+/**
+* Counts the leading keys that sort before the search key: those less
+* than it, or also those equal to it if inclusive. This is the scalar
+* tail of every kernel below.
+*/
+template<typename Key>
+inline std::size_t scanBelow(const Key* keys, std::size_t first, std::size_t count, const Key& key, bool inclusive)
+{
+	while(first < count && (inclusive ? !(key < keys[first]) : keys[first] < key))
+	{
+		++first;
+	}
+	return first;
+}
+
+#if SIMDSEARCH_X86
+
+/*
+	Each kernel walks the keys one vector at a time. The keys are sorted,
+	so the lanes that sort before the search key form a prefix, and the
+	first vector in which not every lane does holds the answer. Unsigned
+	integers are compared as signed ones after flipping their sign bits.
+*/
+
+template<typename Key>
+__attribute__((target("avx2")))
+inline std::size_t searchAvx2(const Key* keys, std::size_t count, const Key& key, bool inclusive,
+	std::integral_constant<int, 8>)
+{
+	const __m256i flip = _mm256_set1_epi64x(std::is_unsigned<Key>::value ? INT64_MIN : 0);
+	const __m256i needle = _mm256_xor_si256(_mm256_set1_epi64x(static_cast<long long>(key)), flip);
+	std::size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256i lanes = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), flip);
+		int below = inclusive
+			? ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(lanes, needle))) & 0xF
+			: _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(needle, lanes)));
+		if(below != 0xF)
+		{
+			return i + __builtin_popcount(below);
+		}
+	}
+	return scanBelow(keys, i, count, key, inclusive);
+}
+
+template<typename Key>
+__attribute__((target("avx2")))
+inline std::size_t searchAvx2(const Key* keys, std::size_t count, const Key& key, bool inclusive,
+	std::integral_constant<int, 4>)
+{
+	const __m256i flip = _mm256_set1_epi32(std::is_unsigned<Key>::value ? INT32_MIN : 0);
+	const __m256i needle = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int>(key)), flip);
+	std::size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256i lanes = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), flip);
+		int below = inclusive
+			? ~_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(lanes, needle))) & 0xFF
+			: _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(needle, lanes)));
+		if(below != 0xFF)
+		{
+			return i + __builtin_popcount(below);
+		}
+	}
+	return scanBelow(keys, i, count, key, inclusive);
+}
+
+__attribute__((target("avx2")))
+inline std::size_t searchAvx2(const float* keys, std::size_t count, const float& key, bool inclusive,
+	std::integral_constant<int, 0>)
+{
+	const __m256 needle = _mm256_set1_ps(key);
+	std::size_t i = 0;
+	for(; i + 8 <= count; i += 8)
+	{
+		__m256 lanes = _mm256_loadu_ps(keys + i);
+		int below = inclusive
+			? _mm256_movemask_ps(_mm256_cmp_ps(lanes, needle, _CMP_LE_OQ))
+			: _mm256_movemask_ps(_mm256_cmp_ps(lanes, needle, _CMP_LT_OQ));
+		if(below != 0xFF)
+		{
+			return i + __builtin_popcount(below);
+		}
+	}
+	return scanBelow(keys, i, count, key, inclusive);
+}
+
+__attribute__((target("avx2")))
+inline std::size_t searchAvx2(const double* keys, std::size_t count, const double& key, bool inclusive,
+	std::integral_constant<int, 0>)
+{
+	const __m256d needle = _mm256_set1_pd(key);
+	std::size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m256d lanes = _mm256_loadu_pd(keys + i);
+		int below = inclusive
+			? _mm256_movemask_pd(_mm256_cmp_pd(lanes, needle, _CMP_LE_OQ))
+			: _mm256_movemask_pd(_mm256_cmp_pd(lanes, needle, _CMP_LT_OQ));
+		if(below != 0xF)
+		{
+			return i + __builtin_popcount(below);
+		}
+	}
+	return scanBelow(keys, i, count, key, inclusive);
+}
+
+template<typename Key>
+__attribute__((target("sse4.2")))
+inline std::size_t searchSse42(const Key* keys, std::size_t count, const Key& key, bool inclusive,
+	std::integral_constant<int, 8>)
+{
+	const __m128i flip = _mm_set1_epi64x(std::is_unsigned<Key>::value ? INT64_MIN : 0);
+	const __m128i needle = _mm_xor_si128(_mm_set1_epi64x(static_cast<long long>(key)), flip);
+	std::size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128i lanes = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), flip);
+		int below = inclusive
+			? ~_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(lanes, needle))) & 0x3
+			: _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(needle, lanes)));
+		if(below != 0x3)
+		{
+			return i + __builtin_popcount(below);
+		}
+	}
+	return scanBelow(keys, i, count, key, inclusive);
+}
+
+template<typename Key>
+__attribute__((target("sse4.2")))
+inline std::size_t searchSse42(const Key* keys, std::size_t count, const Key& key, bool inclusive,
+	std::integral_constant<int, 4>)
+{
+	const __m128i flip = _mm_set1_epi32(std::is_unsigned<Key>::value ? INT32_MIN : 0);
+	const __m128i needle = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(key)), flip);
+	std::size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128i lanes = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i)), flip);
+		int below = inclusive
+			? ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(lanes, needle))) & 0xF
+			: _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(needle, lanes)));
+		if(below != 0xF)
+		{
+			return i + __builtin_popcount(below);
+		}
+	}
+	return scanBelow(keys, i, count, key, inclusive);
+}
+
+__attribute__((target("sse4.2")))
+inline std::size_t searchSse42(const float* keys, std::size_t count, const float& key, bool inclusive,
+	std::integral_constant<int, 0>)
+{
+	const __m128 needle = _mm_set1_ps(key);
+	std::size_t i = 0;
+	for(; i + 4 <= count; i += 4)
+	{
+		__m128 lanes = _mm_loadu_ps(keys + i);
+		int below = inclusive
+			? _mm_movemask_ps(_mm_cmple_ps(lanes, needle))
+			: _mm_movemask_ps(_mm_cmplt_ps(lanes, needle));
+		if(below != 0xF)
+		{
+			return i + __builtin_popcount(below);
+		}
+	}
+	return scanBelow(keys, i, count, key, inclusive);
+}
+
+__attribute__((target("sse4.2")))
+inline std::size_t searchSse42(const double* keys, std::size_t count, const double& key, bool inclusive,
+	std::integral_constant<int, 0>)
+{
+	const __m128d needle = _mm_set1_pd(key);
+	std::size_t i = 0;
+	for(; i + 2 <= count; i += 2)
+	{
+		__m128d lanes = _mm_loadu_pd(keys + i);
+		int below = inclusive
+			? _mm_movemask_pd(_mm_cmple_pd(lanes, needle))
+			: _mm_movemask_pd(_mm_cmplt_pd(lanes, needle));
+		if(below != 0x3)
+		{
+			return i + __builtin_popcount(below);
+		}
+	}
+	return scanBelow(keys, i, count, key, inclusive);
+}
+
+#endif
+
+/**
+* Which kernel family serves a key type: 8 or 4 for integers of that
+* many bytes, 0 for float and double, and -1 for everything else.
+*/
+template<typename Key>
+struct SimdKeyKind
+	: std::integral_constant<int,
+		std::is_floating_point<Key>::value && (sizeof(Key) == 4 || sizeof(Key) == 8) ? 0
+		: std::is_integral<Key>::value && !std::is_same<Key, bool>::value
+			&& (sizeof(Key) == 4 || sizeof(Key) == 8) ? static_cast<int>(sizeof(Key))
+		: -1>
+{
+};
+
+template<typename Key>
+inline std::size_t nodeSearch(const Key* keys, std::size_t count, const Key& key, bool inclusive,
+	std::integral_constant<int, -1>)
+{
+	return inclusive
+		? std::upper_bound(keys, keys + count, key) - keys
+		: std::lower_bound(keys, keys + count, key) - keys;
+}
+
+template<typename Key, int Kind>
+inline std::size_t nodeSearch(const Key* keys, std::size_t count, const Key& key, bool inclusive,
+	std::integral_constant<int, Kind> kind)
+{
+#if SIMDSEARCH_X86
+	switch(simdLevel())
+	{
+		case kSimdAvx2:
+			return searchAvx2(keys, count, key, inclusive, kind);
+		case kSimdSse42:
+			return searchSse42(keys, count, key, inclusive, kind);
+		default:
+			break;
+	}
+#endif
+	return nodeSearch(keys, count, key, inclusive, std::integral_constant<int, -1>());
+}
+
+/**
+* Returns the index of the first of the sorted keys that is not less
+* than the given key.
+*/
+template<typename Key>
+inline std::size_t nodeLowerIndex(const Key* keys, std::size_t count, const Key& key)
+{
+	return nodeSearch(keys, count, key, false, SimdKeyKind<Key>());
+}
+
+/**
+* Returns the index of the first of the sorted keys that is greater
+* than the given key.
+*/
+template<typename Key>
+inline std::size_t nodeUpperIndex(const Key* keys, std::size_t count, const Key& key)
+{
+	return nodeSearch(keys, count, key, true, SimdKeyKind<Key>());
+}
+
+#endif